@@ -8,7 +8,7 @@
 
 class Transformation {
 	public:
-		Transformation(const Matrix m):
+		Transformation(const Matrix& m):
 			_m(m) {};
 
 		~Transformation() {};
@@ -21,11 +21,14 @@ class Transformation {
 			return this->_m;
 		};
 
+		/* w = z/d; z comes out as -d/z after the divide, so it still
+		   grows with the distance to the eye and can be depth tested
+		   (x and y are the same as before) */
 		static Transformation generate_perspective_matrix(double d) {
 			Matrix m = { { 1,  0,  0,  0  },
 						 { 0,  1,  0,  0  },
-						 { 0,  0,  1, 1/d },
-						 { 0,  0,  0,  0  } };
+						 { 0,  0,  0, 1/d },
+						 { 0,  0, -1,  0  } };
 			return Transformation(m);
 		}
 
@@ -136,19 +139,7 @@ class Transformation {
 		};
 
 		Transformation& operator*=(const Transformation& other) {
-			Matrix m1 = this->_m;
-			const Matrix &m2 = other.get_transformation_matrix();
-			int size = m1.size();
-			if (size != m2.size())
-				throw "Transformations have different dimensions";
-			for (int i = 0; i < size; i++) {	 	  	 	     	  		  	  	    	      	 	
-				for (int j = 0; j < size; j++) {
-					_m[i][j] = 0;
-					for (int k = 0; k < size; k++) {
-						_m[i][j] += m1[i][k] * m2[k][j];
-					}
-				}
-			}
+			this->_m = this->_m * other.get_transformation_matrix();
 			return *this;
 		}
 
@@ -160,9 +151,9 @@ class Transformation {
 		friend std::ostream& operator<<(std::ostream& os, const Transformation& t) {
     		const auto &m = t.get_transformation_matrix();
     		int i, j;
-    		for (i = 0; i < m.size(); ++i) {
+    		for (i = 0; i < Matrix::size(); ++i) {
     			os << '[';
-    			for (j = 0; j < m[i].size()-1; ++j) {
+    			for (j = 0; j < Vec4::size()-1; ++j) {
     				os << m[i][j] << ',';
     			}
     			os << m[i][j] << "]\n";
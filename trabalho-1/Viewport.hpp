@@ -1,11 +1,22 @@
 #ifndef VIEWPORT_HPP
 #define VIEWPORT_HPP
 
+#include <cairo.h>
+#include <functional>
 #include "Window.hpp"
 #include "objects.hpp"
-#include "ListaEnc.hpp"
-#include "elemento.hpp"
+#include "vertex_batch.hpp"
+#include "display_file.hpp"
 #include "clipping.hpp"
+#include "worker_pool.hpp"
+#include "bvh.hpp"
+#include "path_batch.hpp"
+#include "rasterizer.hpp"
+#include "frame_stats.hpp"
+
+/* CAIRO fills polygons in display file order, RASTER through Rasterizer
+   with a z-buffer */
+enum class Render_backends { CAIRO, RASTER };
 
 class Viewport {
 	public:
@@ -13,7 +24,9 @@ class Viewport {
 			_width(width),
 			_height(height),
 			_window(new Window(width,height)),
-			_clipper(-1,1,-1,1)
+			_clipper(-1,1,-1,1),
+			_strokes(false),
+			_fills(true)
 		{
 			normalize_and_clip_all_objs();
 		}
@@ -24,118 +37,356 @@ class Viewport {
 		void moveY(double value);
 		void moveZ(double value);
 		void change_view(const window_view view);
+		void set_camera(const Coordinate& center, double angle_x, double angle_y, double angle_z);
 		void set_focal_distance(double d);
 		void rotate_window_on_x(double degrees);
 		void rotate_window_on_y(double degrees);
 		void rotate_window_on_z(double degrees);
 
+		/* Runs the pending normalize/clip pass, if the window changed */
+		void update();
 		void drawDisplayFile(cairo_t* cr);
-		void addObject(Object* obj) { _objetos.adiciona(obj); normalize_and_clip_obj(obj); };
-		Object* getObject(int index) { _objetos.retornaDaPosicao(index);};
-		int get_display_file_size() { return _objetos.tamanho(); };
+		ObjectHandle addObject(Object* obj) { ObjectHandle h = _objetos.add(obj); normalize_and_clip_obj(obj); return h; };
+		Object* getObject(ObjectHandle handle) { return _objetos.get(handle); };
+		const DisplayFile& get_display_file() const { return _objetos; };
+		int get_display_file_size() { return _objetos.size(); };
 		Coordinate transformOneCoordinate(const Coordinate& c) const;
 		Coordinates transformOneCoordinates(const Coordinates& coords) const;
 		void normalize_obj(Object* obj);
 		void normalize_and_clip_obj(Object* obj);
-		void changeLineClipAlg(const Line_clip_algs alg){_clipper.set_line_clip_alg(alg); normalize_and_clip_all_objs();}	 	  	 	     	  		  	  	    	      	 	
+		/* Called whenever the normalized display file changes, i.e. when
+		   there is something new to draw */
+		void set_on_change(std::function<void()> on_change) { _on_change = on_change; }
+		void set_render_backend(const Render_backends backend) { _backend = backend; if (_on_change) _on_change(); }
+		void changeLineClipAlg(const Line_clip_algs alg){_clipper.set_line_clip_alg(alg); invalidate_all_objs(); window_changed();}	 	  	 	     	  		  	  	    	      	 	
 
 	protected:
 	private:
 		Window* _window;
 		Clipping _clipper;
 		double _width, _height;
-		ListaEnc<Object*> _objetos;
+		std::function<void()> _on_change;
+		bool _normalization_pending = false;
+		DisplayFile _objetos;
+		// world coords of the whole display file, packed for VertexBatch::transform
+		VertexBatch _world_coords;
+		VertexBatch _normalized_coords;
+		// Clipping::classify outcode of every vertex of _normalized_coords
+		std::vector<unsigned char> _outcodes;
+		bool _world_coords_dirty = true;
+
+		/* Per object, by display file position; rebuilt with _world_coords */
+		// vertices of object i are [_batch_offsets[i], _batch_offsets[i+1])
+		std::vector<std::size_t> _batch_offsets;
+		// window generation those vertices were transformed with, 0 if stale
+		std::vector<unsigned long> _batch_generations;
+		// clip tasks of object i are [_task_offsets[i], _task_offsets[i+1])
+		std::vector<int> _task_offsets;
+		// outside the window at the last cull
+		std::vector<char> _culled;
+		BVH _bvh;
+
+		/* One unit of clipping work: a whole object, or a range of faces
+		   of an Object3D so that a big mesh is spread over all workers;
+		   batch is where the object's vertices start in _outcodes */
+		struct ClipTask {
+			Object* obj;
+			int begin, end;
+			std::size_t batch;
+		};
+		std::vector<ClipTask> _clip_tasks;
+
+		/* A block of vertices to transform, or only to shift after a pan */
+		struct VertexTask {
+			std::size_t begin, end;
+			bool pan;
+		};
+
+		// work for the current frame: stale objects that survived culling
+		std::vector<int> _visible;
+		std::vector<VertexTask> _vertex_tasks;
+		std::vector<int> _visible_clip_tasks;
+		WorkerPool _workers;
+
+		// everything drawn in a frame, one path per style
+		PathBatch _strokes;
+		PathBatch _fills;
+		Render_backends _backend = Render_backends::CAIRO;
+		Rasterizer _rasterizer;
+		std::vector<Rasterizer::Vertex> _raster_vertices;
+		Coordinate _view_direction; // of the window, for shading
+
+		static const int FACES_PER_TASK = 64;
+		static const std::size_t VERTICES_PER_TASK = 4096;
+		// largest distance, in pixels, between a spline and its polyline
+		static constexpr double CURVE_TOLERANCE = 0.5;
 
 		void normalize_all_objs();
+		void window_changed();
 		void normalize_and_clip_all_objs();
+		void invalidate_all_objs();
+		void tessellate(Curve* curve, const Matrix& m);
+		/* Splines and surfaces skip the vertex batch: normalize_obj
+		   builds their normalized coords from the control points */
+		static bool from_control_points(const Object* obj) {
+			switch (obj->get_type()) {
+				case obj_type::BEZIER_CURVE:
+				case obj_type::BSPLINE_CURVE:
+				case obj_type::BEZIER_SURFACE:
+				case obj_type::BSPLINE_SURFACE:
+					return true;
+				default:
+					return false;
+			}
+		}
 
-		void drawPoint(Object* objeto, cairo_t* cr);
-		void drawLine(Object* objeto, cairo_t* cr);
-		void drawPolygon(Object* objeto, cairo_t* cr);
-		void drawCurve(Object* obj, cairo_t* cr);
-		void drawObj3D(Object3D* obj, cairo_t* cr);
-		void drawSurface(Surface* obj, cairo_t* cr);
+		/* These only add the object to _strokes or _fills, in
+		   viewport coords; drawDisplayFile flushes both to cairo */
+		void collect_display_file();
+		void drawPoint(Object* objeto);
+		void drawLine(Object* objeto);
+		void drawPolygon(Object* objeto);
+		void drawPolygon(const Coordinates& coords, bool filled);
+		void rasterPolygon(const Coordinates& coords, const Coordinate& normal);
+		void drawCurve(Object* obj);
+		void drawObj3D(Object3D* obj);
+		void drawSurface(Surface* obj);
 
 };
 
+/*
+	Navigation only updates the window and marks the normalized coords
+	stale; the scene pass runs once, right before the next draw (or
+	update()), however many changes came in between.
+*/
+void Viewport::window_changed() {
+	_normalization_pending = true;
+	if (_on_change)
+		_on_change();
+}
+
+void Viewport::update() {
+	if (_normalization_pending)
+		normalize_and_clip_all_objs();
+}
+
 void Viewport::zoom(double step) {
 	_window->zoom(step);
-	normalize_and_clip_all_objs();
+	window_changed();
 }
 
 void Viewport::moveX(double step) {
 	_window->moveX(step);
-	normalize_and_clip_all_objs();
+	window_changed();
 }
 
 void Viewport::moveY(double step){
 	_window->moveY(step);
-	normalize_and_clip_all_objs();
+	window_changed();
 }
 
 void Viewport::moveZ(double step){
 	_window->moveZ(step);
-	normalize_and_clip_all_objs();
+	window_changed();
+}
+
+void Viewport::set_camera(const Coordinate& center, double angle_x, double angle_y, double angle_z){
+	_window->set_camera(center, angle_x, angle_y, angle_z);
+	window_changed();
 }
 
 void Viewport::change_view(const window_view view){
 	_window->change_view(view);
-	normalize_and_clip_all_objs();
+	window_changed();
 }
 
 void Viewport::set_focal_distance(double d){
     _window->set_focal_distance(d);
-    normalize_and_clip_all_objs();
+    window_changed();
 }
 
 void Viewport::rotate_window_on_x(double degrees) {
 	_window->rotate_x(degrees);
-	normalize_and_clip_all_objs();
+	window_changed();
 }	 	  	 	     	  		  	  	    	      	 	
 
 void Viewport::rotate_window_on_y(double degrees) {
 	_window->rotate_y(degrees);
-	normalize_and_clip_all_objs();
+	window_changed();
 }
 
 void Viewport::rotate_window_on_z(double degrees) {
 	_window->rotate_z(degrees);
-	normalize_and_clip_all_objs();
+	window_changed();
 }
 
 void Viewport::normalize_and_clip_obj(Object* obj) {
-	Transformation t = _window->get_transformation();
-	obj->set_normalized_coords(t);
+	{
+		FRAME_STATS_TIME(NORMALIZE);
+		normalize_obj(obj);
+	}
+	// obj was just added or changed, the packed world coords are stale
+	_world_coords_dirty = true;
 
-	if(!(_clipper.clip(obj)))
+	FRAME_STATS_TIME(CLIP);
+	if(!(_clipper.clip(obj))) {
 		obj->get_normalized_coords().clear();
+		FRAME_STATS_COUNT(CLIPPED, 1);
+	}
+	obj->set_normalized_generation(_window->get_generation());
+
+	if (_on_change)
+		_on_change();
 }
 
+/*
+	Objects outside the window are culled through the BVH first. Of
+	the rest, only those whose normalized coords are older than the
+	window matrix (or were never computed) are transformed and clipped
+	again; everything else is left as it is.
+*/
 void Viewport::normalize_and_clip_all_objs() {
-	_window->update_transformation();
-	auto t = _window->get_transformation();
-
-	for (int i = 0; i < _objetos.tamanho(); i++) {
-		Object* obj = _objetos.retornaDaPosicao(i);
-		obj->set_normalized_coords(t);
-		if (!(_clipper.clip(obj)))
-			obj->get_normalized_coords().clear();
+	_normalization_pending = false;
+	normalize_all_objs();
+	unsigned long generation = _window->get_generation();
+
+	_visible_clip_tasks.clear();
+	for (int i : _visible)
+		for (int k = _task_offsets[i]; k < _task_offsets[i+1]; ++k)
+			_visible_clip_tasks.push_back(k);
+
+	{
+		FRAME_STATS_TIME(CLIP);
+		_clipper.next_frame();
+		_workers.parallel_for(_visible_clip_tasks.size(), 8, [this](std::size_t i) {
+			const ClipTask& task = _clip_tasks[_visible_clip_tasks[i]];
+			if (task.obj->get_type() == obj_type::OBJECT_3D) {
+				Object3D* obj = (Object3D*) task.obj;
+				obj->build_normalized_faces(task.begin, task.end);
+				_clipper.clip_faces(obj, task.begin, task.end, _outcodes.data() + task.batch);
+			} else {
+				bool draw;
+				if (from_control_points(task.obj)) {
+					normalize_obj(task.obj);
+					draw = _clipper.clip(task.obj);
+				} else {
+					draw = _clipper.clip(task.obj, _outcodes.data() + task.batch);
+				}
+				if (!draw) {
+					task.obj->get_normalized_coords().clear();
+					FRAME_STATS_COUNT(CLIPPED, 1);
+				}
+			}
+		});
 	}
+	// parallel_for has joined: drawing now sees every object fully clipped
+
+	for (int i : _visible)
+		_objetos[i]->set_normalized_generation(generation);
+}
+
+void Viewport::invalidate_all_objs() {
+	for (auto obj : _objetos)
+		obj->set_normalized_generation(0);
 }
 
 void Viewport::normalize_obj(Object* obj) {
-	Transformation t = _window->get_transformation();
-	obj->set_normalized_coords(t);
+	const Transformation& t = _window->get_transformation();
+	if (obj->get_type() == obj_type::BEZIER_CURVE || obj->get_type() == obj_type::BSPLINE_CURVE)
+		tessellate((Curve*) obj, t.get_transformation_matrix());
+	else
+		obj->set_normalized_coords(t);
+}
+
+/* Splines are sampled in normalized coords, as finely as their size on
+   the viewport asks for, every time the window changes */
+void Viewport::tessellate(Curve* curve, const Matrix& m) {
+	curve->tessellate(m, _width/2, _height/2, CURVE_TOLERANCE);
+	FRAME_STATS_COUNT(VERTICES, curve->get_normalized_coords().size());
 }
 
 void Viewport::normalize_all_objs() {	 	  	 	     	  		  	  	    	      	 	
-	_window->update_transformation();
-	auto t = _window->get_transformation();
+	{
+		FRAME_STATS_TIME(WINDOW);
+		_window->update_transformation();
+	}
+	const Matrix& m = _window->get_transformation().get_transformation_matrix();
+	unsigned long generation = _window->get_generation();
+
+	if (_world_coords_dirty) {
+		std::vector<BoundingBox> boxes;
+		_world_coords.clear();
+		_batch_offsets.clear();
+		_task_offsets.clear();
+		_clip_tasks.clear();
+		for (auto obj : _objetos) {
+			_batch_offsets.push_back(_world_coords.size());
+			obj->collect_coords(_world_coords);
+			boxes.push_back(obj->get_bounding_box());
+
+			_task_offsets.push_back(_clip_tasks.size());
+			if (obj->get_type() == obj_type::OBJECT_3D) {
+				int faces = ((Object3D*) obj)->get_mesh().face_count();
+				for (int f = 0; f < faces; f += FACES_PER_TASK)
+					_clip_tasks.push_back({obj, f, std::min(f + FACES_PER_TASK, faces), _batch_offsets.back()});
+			} else {
+				_clip_tasks.push_back({obj, 0, 0, _batch_offsets.back()});
+			}
+		}
+		_batch_offsets.push_back(_world_coords.size());
+		_task_offsets.push_back(_clip_tasks.size());
+
+		_normalized_coords.resize(_world_coords.size());
+		_outcodes.resize(_world_coords.size());
+		_batch_generations.assign(_objetos.size(), 0);
+		_culled.assign(_objetos.size(), 0);
+		_bvh.build(boxes);
+		_world_coords_dirty = false;
+	}
 
-	for (int i = 0; i < _objetos.tamanho(); i++) {
-		Object* obj = _objetos.retornaDaPosicao(i);
-		obj->set_normalized_coords(t);
+	_visible.clear();
+	_bvh.cull(m,
+		[&](int i) {
+			_culled[i] = 0;
+			if (_objetos[i]->get_normalized_generation() != generation)
+				_visible.push_back(i);
+		},
+		[&](int i) {
+			if (!_culled[i]) {
+				_objetos[i]->clear_normalized_coords();
+				_objetos[i]->set_normalized_generation(0);
+				_culled[i] = 1;
+			}
+		});
+
+	FRAME_STATS_TIME(NORMALIZE);
+	// a parallel pan only shifts what was transformed one generation ago
+	bool pan = _window->last_update_was_pan();
+	_vertex_tasks.clear();
+	for (int i : _visible) {
+		bool shift = pan && _batch_generations[i] != 0 && _batch_generations[i] + 1 == generation;
+		for (std::size_t b = _batch_offsets[i]; b < _batch_offsets[i+1]; b += VERTICES_PER_TASK)
+			_vertex_tasks.push_back({b, std::min(b + VERTICES_PER_TASK, _batch_offsets[i+1]), shift});
+		_batch_generations[i] = generation;
 	}
+
+	const Coordinate& d = _window->pan_offset();
+	_workers.parallel_for(_vertex_tasks.size(), 4, [&](std::size_t i) {
+		const VertexTask& task = _vertex_tasks[i];
+		FRAME_STATS_COUNT(VERTICES, task.end - task.begin);
+		if (task.pan)
+			_normalized_coords.translate(task.begin, task.end, d[0], d[1], d[2]);
+		else
+			VertexBatch::transform(m, _world_coords, _normalized_coords, task.begin, task.end);
+		// while the block is still in cache
+		_clipper.classify(_normalized_coords, task.begin, task.end, _outcodes.data());
+	});
+
+	_workers.parallel_for(_visible.size(), 64, [this](std::size_t k) {
+		int i = _visible[k];
+		std::size_t offset = _batch_offsets[i];
+		_objetos[i]->scatter_normalized_coords(_normalized_coords, offset);
+	});
 }
 
 Coordinate Viewport::transformOneCoordinate(const Coordinate& coord) const {
@@ -148,6 +399,7 @@ Coordinate Viewport::transformOneCoordinate(const Coordinate& coord) const {
 }
 
 Coordinates Viewport::transformOneCoordinates(const Coordinates& coords) const {
+	FRAME_STATS_TIME(VIEWPORT);
 	Coordinates transformed_vector;
 
 	for (int i = 0; i < coords.size(); ++i)
@@ -156,92 +408,160 @@ Coordinates Viewport::transformOneCoordinates(const Coordinates& coords) const {
 	return transformed_vector;
 }
 
-void Viewport::drawPoint(Object* objeto, cairo_t* cr) {
+void Viewport::drawPoint(Object* objeto) {
 	if (objeto->get_normalized_coords().size() == 0)
 		return;
 	Coordinate coord = transformOneCoordinate(objeto->get_normalized_coord_at_index(0));
-	//prepareContext();
-	cairo_move_to(cr, coord[0]+10, coord[1]+10);
-	cairo_arc(cr, coord[0]+10, coord[1]+10, 1.0, 0.0, (2*G_PI) );
-	cairo_fill(cr);
+	_fills.circle(coord[0]+10, coord[1]+10, 1.0);
+	FRAME_STATS_COUNT(SEGMENTS, 1);
 }	 	  	 	     	  		  	  	    	      	 	
 
-void Viewport::drawLine(Object* objeto, cairo_t* cr) {
-	Coordinates transformed_vector = transformOneCoordinates(objeto->get_normalized_coords());
-	if (transformed_vector.size() == 0)
+void Viewport::drawLine(Object* objeto) {
+	const Coordinates& coords = objeto->get_normalized_coords();
+	if (coords.size() == 0)
 		return;
-	cairo_move_to(cr, transformed_vector[0][0]+10, transformed_vector[0][1]+10);
-	cairo_line_to(cr, transformed_vector[1][0]+10, transformed_vector[1][1]+10);
-	cairo_stroke(cr);
+	Coordinate a = transformOneCoordinate(coords[0]);
+	Coordinate b = transformOneCoordinate(coords[1]);
+	_strokes.move_to(a[0]+10, a[1]+10);
+	_strokes.line_to(b[0]+10, b[1]+10);
+	FRAME_STATS_COUNT(SEGMENTS, 1);
+}
+
+void Viewport::drawPolygon(Object* obj) {
+	if (obj->isFilled() && _backend == Render_backends::RASTER)
+		rasterPolygon(obj->get_normalized_coords(), ((Polygon*) obj)->get_normal());
+	else
+		drawPolygon(obj->get_normalized_coords(), obj->isFilled());
 }
 
-void Viewport::drawPolygon(Object* obj,cairo_t* cr) {
-	Coordinates transformed_vector = transformOneCoordinates(obj->get_normalized_coords());
-	if (transformed_vector.size() == 0)
+void Viewport::drawPolygon(const Coordinates& coords, bool filled) {
+	if (coords.size() == 0)
 		return;
-	cairo_move_to(cr, transformed_vector[0][0]+10, transformed_vector[0][1]+10);
-	for (int i = 1; i < transformed_vector.size(); ++i)
-		cairo_line_to(cr, transformed_vector[i][0]+10, transformed_vector[i][1]+10);
-	cairo_line_to(cr, transformed_vector[0][0]+10, transformed_vector[0][1]+10);
-	if(obj->isFilled()) {
-		cairo_fill(cr);
-	} else {
-		cairo_stroke(cr); 
+	PathBatch& batch = filled ? _fills : _strokes;
+	Coordinate c = transformOneCoordinate(coords[0]);
+	batch.move_to(c[0]+10, c[1]+10);
+	for (int i = 1; i < coords.size(); ++i) {
+		c = transformOneCoordinate(coords[i]);
+		batch.line_to(c[0]+10, c[1]+10);
 	}
+	batch.close_polygon();
+	FRAME_STATS_COUNT(SEGMENTS, coords.size());
 }
 
-void Viewport::drawCurve(Object* obj, cairo_t* cr) {
-	Coordinates transformed_vector = transformOneCoordinates(obj->get_normalized_coords());
-	if (transformed_vector.size() == 0)
+/*
+	Flat shaded by the world space normal: black when the polygon faces
+	the window, like cairo would fill it, lighter as it turns sideways,
+	so that faces stay apart from each other and from the strokes
+*/
+void Viewport::rasterPolygon(const Coordinates& coords, const Coordinate& normal) {
+	if (coords.size() < 3)
 		return;
-	cairo_move_to(cr, transformed_vector[0][0]+10, transformed_vector[0][1]+10);
-	for (int i = 1; i < transformed_vector.size(); ++i)
-		cairo_line_to(cr, transformed_vector[i][0]+10, transformed_vector[i][1]+10);
-	cairo_stroke(cr);
+	const Coordinate& view = _view_direction;
+	double length = std::sqrt(normal[0]*normal[0] + normal[1]*normal[1] + normal[2]*normal[2]);
+	double facing = length > 0 ? std::fabs(normal[0]*view[0] + normal[1]*view[1] + normal[2]*view[2]) / length : 1;
+	std::uint32_t gray = (std::uint32_t) std::lround((1 - facing) * 0.8 * 255);
+	std::uint32_t color = 0xff000000u | gray << 16 | gray << 8 | gray;
+
+	_raster_vertices.clear();
+	for (const auto &coord : coords) {
+		Coordinate c = transformOneCoordinate(coord);
+		_raster_vertices.push_back({(float) c[0], (float) c[1], (float) coord[2]});
+	}
+	_rasterizer.add_polygon(_raster_vertices.data(), _raster_vertices.size(), color);
+	FRAME_STATS_COUNT(SEGMENTS, coords.size());
+}
+
+void Viewport::drawCurve(Object* obj) {
+	const Coordinates& coords = obj->get_normalized_coords();
+	if (coords.size() == 0)
+		return;
+	Coordinate c = transformOneCoordinate(coords[0]);
+	_strokes.move_to(c[0]+10, c[1]+10);
+	for (int i = 1; i < coords.size(); ++i) {
+		c = transformOneCoordinate(coords[i]);
+		_strokes.line_to(c[0]+10, c[1]+10);
+	}
+	FRAME_STATS_COUNT(SEGMENTS, coords.size() - 1);
 
 }
 
-void Viewport::drawObj3D(Object3D* obj, cairo_t* cr) {	 	  	 	     	  		  	  	    	      	 	
-	for (auto &face : obj->get_face_list()) {
-		if (face.get_normalized_coords().size() > 0)
-			drawPolygon(&face, cr);
+void Viewport::drawObj3D(Object3D* obj) {	 	  	 	     	  		  	  	    	      	 	
+	const auto &mesh = obj->get_mesh();
+	auto &faces = obj->get_normalized_faces();
+	bool raster = _backend == Render_backends::RASTER;
+	for (int f = 0; f < faces.size(); ++f) {
+		if (faces[f].size() == 0)
+			continue;
+		if (raster && mesh.is_face_filled(f))
+			rasterPolygon(faces[f], mesh.face_normal(f));
+		else
+			drawPolygon(faces[f], mesh.is_face_filled(f));
 	}
 }
 
-void Viewport::drawSurface(Surface* obj, cairo_t* cr) {
+void Viewport::drawSurface(Surface* obj) {
 	for (auto &curve : obj->get_curve_list()) {
 		if (curve.get_normalized_coords().size() > 0) {
-			drawCurve(&curve, cr);
+			drawCurve(&curve);
 		}
 	}
 }
 
+/*
+	Collects the whole display file into one stroked and one filled
+	path and draws them with a single cairo call each. Everything is
+	drawn with the source and line width already set on cr, so the
+	order between primitives of one style does not change the image.
+	With the RASTER backend filled polygons go to the rasterizer
+	instead, which is drawn first, under everything else.
+*/
 void Viewport::drawDisplayFile(cairo_t* cr) {
+	update();
+	FRAME_STATS_TIME(DRAW);
+	bool raster = _backend == Render_backends::RASTER;
+	if (raster) {
+		_rasterizer.begin(std::ceil(_width), std::ceil(_height));
+		_view_direction = _window->view_direction();
+	}
+	collect_display_file();
+	if (raster)
+		_rasterizer.draw(cr, 10, 10, _workers);
+	_fills.flush(cr);
+	_strokes.flush(cr);
+}
+
+void Viewport::collect_display_file() {
+	FRAME_STATS_TIME(VIEWPORT);
+	// culling results only hold while the display file is unchanged
+	bool skip_culled = !_world_coords_dirty;
 	//percorrer o displayfile enviando os objetos para o respectivo draw
-	for (int i = 0; i < _objetos.tamanho(); ++i) {
-		auto obj = _objetos.retornaDaPosicao(i);
+	for (int i = 0; i < _objetos.size(); ++i) {
+		if (skip_culled && _culled[i])
+			continue;
+		Object* obj = _objetos[i];
+		FRAME_STATS_COUNT(OBJECTS, 1);
 		switch(obj->get_type()) {
 			case obj_type::OBJECT:
 				break;
 			case obj_type::POINT:
-				drawPoint(obj, cr);
+				drawPoint(obj);
 				break;
 			case obj_type::LINE:
-				drawLine(obj, cr);
+				drawLine(obj);
 				break;
 			case obj_type::POLYGON:
-				drawPolygon(obj, cr);
+				drawPolygon(obj);
 				break;
 			case obj_type::BSPLINE_CURVE:
 			case obj_type::BEZIER_CURVE:
-				drawCurve(obj, cr);
+				drawCurve(obj);
 				break;
 			case obj_type::OBJECT_3D:
-				drawObj3D((Object3D*) obj, cr);
+				drawObj3D((Object3D*) obj);
 				break;
 			case obj_type::BEZIER_SURFACE:
 			case obj_type::BSPLINE_SURFACE:
-				drawSurface((Surface*) obj, cr);
+				drawSurface((Surface*) obj);
 				break;
 			default:
 				break;
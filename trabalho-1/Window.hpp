@@ -13,11 +13,10 @@ class Window {
 			_center(width/2, height/2, 0),
 			_width(width),
 			_heigth(height),
-			_t({ {1, 0, 0, 0},
-				 {0, 1, 0, 0},
-				 {0, 0, 1, 0},
-				 {0, 0, 0, 1} })
-		{}
+			_t(Matrix::identity())
+		{
+			update_orientation();
+		}
 		
 		virtual ~Window() {}
 
@@ -28,9 +27,9 @@ class Window {
 		double get_angle_y() { return _angle_y; }
 		double get_angle_z() { return _angle_z; }
 
-		void rotate_x(double degrees) { _angle_x += degrees; }
-		void rotate_y(double degrees) { _angle_y += degrees; }
-		void rotate_z(double degrees) { _angle_z += degrees; }
+		void rotate_x(double degrees) { _angle_x += degrees; update_orientation(); }
+		void rotate_y(double degrees) { _angle_y += degrees; update_orientation(); }
+		void rotate_z(double degrees) { _angle_z += degrees; update_orientation(); }
 
 		void zoom(double step);
 
@@ -38,37 +37,75 @@ class Window {
 		void moveY(double value);
 		void moveZ(double value);
 
-		void change_view(const window_view view) { _view = view; }
-		void set_focal_distance(double fov) { _d = (_width/2)/tan(fov/2); }
+		/* Places the window at center, looking along the given angles (degrees) */
+		void set_camera(const Coordinate& center, double angle_x, double angle_y, double angle_z) {
+			_center = center;
+			_angle_x = angle_x;
+			_angle_y = angle_y;
+			_angle_z = angle_z;
+			update_orientation();
+		}
+
+		void change_view(const window_view view) { _view = view; _dirty = true; }
+		void set_focal_distance(double fov) { _d = (_width/2)/tan(fov/2); _dirty = true; }
 
 		Coordinate lowmin() const { return Coordinate(-1,-1); }	 	  	 	     	  		  	  	    	      	 	
 		Coordinate uppermax() const { return Coordinate(1,1); }
 		Coordinate center() const { return _center; }
 
+		/* World space direction the window looks at (its local +z) */
+		Coordinate view_direction() const { return axis(2); }
+
 		Transformation& get_transformation() { return _t; }
 		void update_transformation();
 
+		/* Bumped every time update_transformation actually changes _t */
+		unsigned long get_generation() const { return _generation; }
+
+		/* True if the last update only moved a parallel window: then
+		   new normalized coords = old normalized coords + pan_offset() */
+		bool last_update_was_pan() const { return _last_update_was_pan; }
+		const Coordinate& pan_offset() const { return _pan_offset; }
+
 	protected:
 	private:
+		/* Moves along the window's own axes */
 		void move(double x, double y, double z) {
-			Coordinate c(x,y,z);
-			auto t = Transformation::generate_rotation_matrix(_angle_x, _angle_y, _angle_z);
-			c.transform(t.get_transformation_matrix());
-			_center += c;
+			for (int i = 0; i < 3; ++i)
+				_center[i] += x * _rotation[i][0] + y * _rotation[i][1] + z * _rotation[i][2];
+			_moved = true;
+		}
+
+		void update_orientation();
+
+		/* Local axis i of the window in world coords: column i of _rotation */
+		Coordinate axis(int i) const {
+			return Coordinate(_rotation[0][i], _rotation[1][i], _rotation[2][i]);
 		}
 
 		Coordinate _center;
-		double _angle_x = 0, _angle_y = 0, _angle_z = 0; // radians
+		double _angle_x = 0, _angle_y = 0, _angle_z = 0; // degrees
+		// world to window rotation, rows 0-2 of rx(-x) * ry(-y) * rz(-z)
+		// (Transformation's matrices); only rebuilt when an angle changes
+		Matrix _rotation;
 		double _width, _heigth;
 		double _d = 1000;
 		window_view _view = window_view::PERSPECTIVE;
 		Transformation _t;
+
+		// what changed since the last update_transformation
+		bool _dirty = true;
+		bool _moved = false;
+		unsigned long _generation = 0;
+		bool _last_update_was_pan = false;
+		Coordinate _pan_offset;
 };
 
 /* step > 0  -  Zoom in */
 void Window::zoom(double step) {
 	_width -= step;
 	_heigth -= step;
+	_dirty = true;
 }
 
 /* Move Window Horizontally */
@@ -85,23 +122,69 @@ void Window::moveZ(double value) {
 	move(0, 0, value);
 }
 
+/*
+	rx(-x) * ry(-y) * rz(-z) multiplied out, with one sin/cos per angle
+*/
+void Window::update_orientation() {
+	double a = Transformation::to_radians(_angle_x);
+	double b = Transformation::to_radians(_angle_y);
+	double c = Transformation::to_radians(_angle_z);
+	double ca = cos(a), sa = sin(a), cb = cos(b), sb = sin(b), cc = cos(c), sc = sin(c);
+
+	_rotation = Matrix({ {cb*cc,               cb*sc,               -sb,   0},
+						 {-ca*sc + sa*sb*cc,   ca*cc + sa*sb*sc,    sa*cb, 0},
+						 {sa*sc + ca*sb*cc,    -sa*cc + ca*sb*sc,   ca*cb, 0},
+						 {0,                   0,                   0,     1} });
+	_dirty = true;
+}
+
+/*
+	Builds translation * rotation * (perspective) * scaling in one step:
+	the rotation comes from the cached _rotation, the translation row is
+	the window center turned by it, and perspective and scaling only
+	place those numbers in their columns.
+*/
 void Window::update_transformation() {
-	_t = Transformation({ {1, 0, 0, 0},
-						  {0, 1, 0, 0},
-						  {0, 0, 1, 0},
-						  {0, 0, 0, 1} });
+	if (!_dirty && !_moved)
+		return;
+
+	// a parallel window that only moved keeps the same linear part,
+	// only the translation row of _t changes
+	bool pan = !_dirty && _view == window_view::PARALLEL && _generation > 0;
+	Vec4 old_translation = _t.get_transformation_matrix()[3];
+
+	double s[3] = {1/(_width/2), 1/(_heigth/2), 4.0/(_width + _heigth)};
+	Coordinate t(-_center[0], -_center[1], -_center[2]);
+	if (_view == window_view::PERSPECTIVE)
+		t[2] += _d;
+	// translation turned by the rotation
+	double q[3];
+	for (int j = 0; j < 3; ++j)
+		q[j] = t[0] * _rotation[0][j] + t[1] * _rotation[1][j] + t[2] * _rotation[2][j];
+
+	Matrix& m = _t.get_transformation_matrix();
 	switch(_view) {
 		case window_view::PERSPECTIVE:
-			_t *= Transformation::generate_translation_matrix(-_center[0], -_center[1], -_center[2] + _d);
-			_t *= Transformation::generate_rotation_matrix(-_angle_x, -_angle_y, -_angle_z);
-			_t *= Transformation::generate_perspective_matrix(_d);
-			_t *= Transformation::generate_scaling_matrix(1/(_width/2), 1/(_heigth/2), 4.0/(_width + _heigth));
+			// see Transformation::generate_perspective_matrix: w = z/d and
+			// z = -1 before the divide
+			for (int i = 0; i < 3; ++i)
+				m[i] = Vec4{ {_rotation[i][0] * s[0], _rotation[i][1] * s[1], 0, _rotation[i][2] / _d} };
+			m[3] = Vec4{ {q[0] * s[0], q[1] * s[1], -s[2], q[2] / _d} };
 			break;
 		case window_view::PARALLEL:
-			_t *= Transformation::generate_translation_matrix(-_center[0], -_center[1], -_center[2]);
-			_t *= Transformation::generate_rotation_matrix(-_angle_x, -_angle_y, -_angle_z);
-			_t *= Transformation::generate_scaling_matrix(1/(_width/2), 1/(_heigth/2), 4.0/(_width + _heigth));
+			for (int i = 0; i < 3; ++i)
+				m[i] = Vec4{ {_rotation[i][0] * s[0], _rotation[i][1] * s[1], _rotation[i][2] * s[2], 0} };
+			m[3] = Vec4{ {q[0] * s[0], q[1] * s[1], q[2] * s[2], 1} };
 	}
+
+	const Vec4& translation = m[3];
+	_last_update_was_pan = pan;
+	_pan_offset = Coordinate(translation[0] - old_translation[0],
+							 translation[1] - old_translation[1],
+							 translation[2] - old_translation[2]);
+	_dirty = false;
+	_moved = false;
+	++_generation;
 }
 
 #endif
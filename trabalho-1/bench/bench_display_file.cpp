@@ -0,0 +1,148 @@
+/*
+	Display file benchmark: the old ListaEnc<Object*> against DisplayFile
+	with 1k, 10k and 100k points and lines.
+
+	load:  appending every object to the container
+	frame: the three passes the Viewport makes per frame (scatter the
+	       normalized coords, clip, draw), with the same per-object work
+	       for both containers; ListaEnc reaches object i through
+	       retornaDaPosicao(i), DisplayFile through operator[]
+	viewport: a real Viewport frame (normalize_and_clip_all_objs through
+	       moveX(0), then drawDisplayFile) on the new container
+
+	ListaEnc is quadratic, so at 100k it is timed once, and that alone
+	takes around 10 minutes.
+
+	cd trabalho-1
+	g++ -std=c++17 -O2 -march=native -pthread bench/bench_display_file.cpp -o bench_display_file `pkg-config --cflags --libs cairo`
+	./bench_display_file
+*/
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <vector>
+#include "../Viewport.hpp"
+#include "../ListaEnc.hpp"
+
+template <typename F>
+static double median_ms(int runs, F f) {
+	std::vector<double> times;
+	for (int i = 0; i < runs; ++i) {
+		auto start = std::chrono::steady_clock::now();
+		f();
+		auto end = std::chrono::steady_clock::now();
+		times.push_back(std::chrono::duration<double, std::milli>(end - start).count());
+	}
+	std::sort(times.begin(), times.end());
+	return times[times.size()/2];
+}
+
+static std::vector<Object*> make_scene(int n) {
+	std::mt19937 rng(42);
+	std::uniform_real_distribution<double> d(-100, 600);
+	std::vector<Object*> objs;
+	objs.reserve(n);
+	for (int i = 0; i < n; ++i) {
+		std::string name = "obj" + std::to_string(i);
+		if (i % 2 == 0)
+			objs.push_back(new Point(name, d(rng), d(rng), d(rng)));
+		else
+			objs.push_back(new Line(name, d(rng), d(rng), d(rng), d(rng), d(rng), d(rng)));
+	}
+	return objs;
+}
+
+static void draw(const Viewport& vp, Object* obj, cairo_t* cr) {
+	const auto &coords = obj->get_normalized_coords();
+	if (coords.size() == 0)
+		return;
+	Coordinate c0 = vp.transformOneCoordinate(coords[0]);
+	if (obj->get_type() == obj_type::POINT) {
+		cairo_move_to(cr, c0[0]+10, c0[1]+10);
+		cairo_arc(cr, c0[0]+10, c0[1]+10, 1.0, 0.0, 2*PI);
+		cairo_fill(cr);
+	} else {
+		Coordinate c1 = vp.transformOneCoordinate(coords[1]);
+		cairo_move_to(cr, c0[0]+10, c0[1]+10);
+		cairo_line_to(cr, c1[0]+10, c1[1]+10);
+		cairo_stroke(cr);
+	}
+}
+
+int main() {
+	cairo_surface_t* surface = cairo_image_surface_create(CAIRO_FORMAT_ARGB32, 530, 535);
+	cairo_t* cr = cairo_create(surface);
+
+	Viewport viewport(510, 515);
+	Window window(510, 515);
+	window.update_transformation();
+	const Matrix& m = window.get_transformation().get_transformation_matrix();
+	Clipping clipper(-1, 1, -1, 1);
+
+	std::printf("%8s %14s %14s %16s %16s %14s\n",
+				"objects", "ListaEnc load", "DF load", "ListaEnc frame", "DF frame", "viewport frame");
+
+	for (int n : {1000, 10000, 100000}) {
+		std::vector<Object*> objs = make_scene(n);
+		VertexBatch world, normalized;
+		for (auto obj : objs)
+			obj->collect_coords(world);
+
+		// same work per object, only the way object i is reached differs
+		auto frame = [&](auto at) {
+			VertexBatch::transform(m, world, normalized);
+			std::size_t offset = 0;
+			for (int i = 0; i < n; ++i)
+				at(i)->scatter_normalized_coords(normalized, offset);
+			for (int i = 0; i < n; ++i) {
+				Object* obj = at(i);
+				if (!clipper.clip(obj))
+					obj->get_normalized_coords().clear();
+			}
+			for (int i = 0; i < n; ++i)
+				draw(viewport, at(i), cr);
+		};
+
+		int list_runs = n >= 100000 ? 1 : 5;
+
+		ListaEnc<Object*> list;
+		double list_load = median_ms(list_runs, [&] {
+			list.destroiLista();
+			for (auto obj : objs)
+				list.adiciona(obj);
+		});
+		double list_frame = median_ms(list_runs, [&] {
+			frame([&](int i) { return list.retornaDaPosicao(i); });
+		});
+		list.destroiLista();
+
+		double df_frame, df_load;
+		{
+			DisplayFile df;
+			df_load = median_ms(1, [&] {
+				for (auto obj : objs)
+					df.add(obj);
+			});
+			df_frame = median_ms(11, [&] {
+				frame([&](int i) { return df[i]; });
+			});
+		}	// df deletes objs
+
+		Viewport vp(510, 515);
+		for (auto obj : make_scene(n))
+			vp.addObject(obj);
+		double vp_frame = median_ms(11, [&] {
+			vp.moveX(0);
+			vp.drawDisplayFile(cr);
+		});
+
+		std::printf("%8d %14.3f %14.3f %16.3f %16.3f %14.3f\n",
+					n, list_load, df_load, list_frame, df_frame, vp_frame);
+		std::fflush(stdout);
+	}
+
+	cairo_destroy(cr);
+	cairo_surface_destroy(surface);
+	return 0;
+}
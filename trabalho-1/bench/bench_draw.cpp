@@ -0,0 +1,141 @@
+/*
+	Draw stage benchmark: Viewport::drawDisplayFile, which hands the
+	whole frame to cairo as one stroked and one filled path, against
+	the per-primitive drawing it replaced (a cairo_stroke or cairo_fill
+	per face), on a grid mesh of about 100k triangles covering the
+	window, one face in every filled_every filled. The last row fills
+	through the z-buffer rasterizer instead (Render_backends::RASTER),
+	with the unfilled faces still stroked by cairo.
+
+	The scene is normalized and clipped once before timing, so all
+	rows only measure the draw stage: normalized to viewport transform,
+	path building and cairo rasterization into an image surface.
+
+	cd trabalho-1
+	g++ -std=c++17 -O2 -march=native -pthread bench/bench_draw.cpp -o bench_draw `pkg-config --cflags --libs cairo`
+	./bench_draw [faces] [filled_every] [png prefix]
+*/
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+#include "../Viewport.hpp"
+
+static const int VIEWPORT_WIDTH = 510, VIEWPORT_HEIGHT = 515;
+static const int SURFACE_WIDTH = 530, SURFACE_HEIGHT = 535;
+
+template <typename F>
+static double median_ms(int runs, F f) {
+	std::vector<double> times;
+	for (int i = 0; i < runs; ++i) {
+		auto start = std::chrono::steady_clock::now();
+		f();
+		auto end = std::chrono::steady_clock::now();
+		times.push_back(std::chrono::duration<double, std::milli>(end - start).count());
+	}
+	std::sort(times.begin(), times.end());
+	return times[times.size()/2];
+}
+
+/* n x n quads split in two triangles, slightly wavy in z */
+static Object3D* make_grid(int faces, int filled_every) {
+	int n = std::max(1, (int) std::sqrt(faces / 2.0));
+	IndexedMesh mesh;
+	mesh.reserve((n+1)*(n+1), 6*n*n, 2*n*n);
+	for (int j = 0; j <= n; ++j)
+		for (int i = 0; i <= n; ++i)
+			mesh.add_vertex(Coordinate(VIEWPORT_WIDTH * i / (double) n,
+									   VIEWPORT_HEIGHT * j / (double) n,
+									   10 * std::sin(i * 0.1) * std::cos(j * 0.1)));
+
+	int f = 0;
+	for (int j = 0; j < n; ++j)
+		for (int i = 0; i < n; ++i) {
+			int a = j*(n+1) + i, b = a + 1, c = a + n + 1, d = c + 1;
+			int t1[3] = {a, b, d}, t2[3] = {a, d, c};
+			mesh.add_face(t1, 3, filled_every > 0 && f++ % filled_every == 0);
+			mesh.add_face(t2, 3, filled_every > 0 && f++ % filled_every == 0);
+		}
+	return new Object3D("grid", std::move(mesh));
+}
+
+/* What drawObj3D did before: transform, build and draw each face on its own */
+static void draw_per_face(const Viewport& vp, Object3D* obj, cairo_t* cr) {
+	const auto &mesh = obj->get_mesh();
+	auto &faces = obj->get_normalized_faces();
+	for (int f = 0; f < faces.size(); ++f) {
+		if (faces[f].size() == 0)
+			continue;
+		Coordinates t = vp.transformOneCoordinates(faces[f]);
+		cairo_move_to(cr, t[0][0]+10, t[0][1]+10);
+		for (int i = 1; i < t.size(); ++i)
+			cairo_line_to(cr, t[i][0]+10, t[i][1]+10);
+		cairo_line_to(cr, t[0][0]+10, t[0][1]+10);
+		if (mesh.is_face_filled(f))
+			cairo_fill(cr);
+		else
+			cairo_stroke(cr);
+	}
+}
+
+static void clear(cairo_t* cr) {
+	cairo_set_source_rgb(cr, 1, 1, 1);
+	cairo_paint(cr);
+	cairo_set_source_rgb(cr, 0, 0, 0);
+	cairo_set_line_width(cr, 1.0);
+}
+
+int main(int argc, char* argv[]) {
+	int faces = argc > 1 ? std::atoi(argv[1]) : 100000;
+	int filled_every = argc > 2 ? std::atoi(argv[2]) : 4;
+	std::string png = argc > 3 ? argv[3] : "";
+
+	cairo_surface_t* surface = cairo_image_surface_create(CAIRO_FORMAT_ARGB32, SURFACE_WIDTH, SURFACE_HEIGHT);
+	cairo_t* cr = cairo_create(surface);
+
+	Viewport viewport(VIEWPORT_WIDTH, VIEWPORT_HEIGHT);
+	Object3D* grid = make_grid(faces, filled_every);
+	viewport.addObject(grid);
+	viewport.update();
+
+	int visible = 0;
+	for (const auto &face : grid->get_normalized_faces())
+		visible += face.size() > 0;
+	std::printf("%d faces (%d visible), 1 in %d filled\n", grid->get_mesh().face_count(), visible, filled_every);
+
+	double per_face = median_ms(11, [&] {
+		clear(cr);
+		draw_per_face(viewport, grid, cr);
+		cairo_surface_flush(surface);
+	});
+	if (!png.empty())
+		cairo_surface_write_to_png(surface, (png + "_per_face.png").c_str());
+
+	double batched = median_ms(11, [&] {
+		clear(cr);
+		viewport.drawDisplayFile(cr);
+		cairo_surface_flush(surface);
+	});
+	if (!png.empty())
+		cairo_surface_write_to_png(surface, (png + "_batched.png").c_str());
+
+	viewport.set_render_backend(Render_backends::RASTER);
+	double raster = median_ms(11, [&] {
+		clear(cr);
+		viewport.drawDisplayFile(cr);
+		cairo_surface_flush(surface);
+	});
+	if (!png.empty())
+		cairo_surface_write_to_png(surface, (png + "_raster.png").c_str());
+
+	std::printf("%-28s %10.3f ms\n", "per face stroke/fill", per_face);
+	std::printf("%-28s %10.3f ms  (%.2fx)\n", "one path per style", batched, per_face / batched);
+	std::printf("%-28s %10.3f ms  (%.2fx)\n", "z-buffer rasterizer", raster, per_face / raster);
+
+	cairo_destroy(cr);
+	cairo_surface_destroy(surface);
+	return 0;
+}
@@ -0,0 +1,220 @@
+/*
+	Line clipping benchmark: Cohen-Sutherland, Liang-Barsky,
+	Nicholl-Lee-Nicholl and AUTO (Line_clip_algs) through Clipping::clip,
+	on synthetic segments in normalized coords:
+		inside      90% inside the window, the rest straddling it
+		outside     90% outside (sharing an outcode bit), the rest straddling
+		straddling  a quarter of each of the three below, and long lines
+		            from inside the window to anywhere outside it
+		one edge    short lines from inside the window to past one edge
+		both out    both ends outside, half of them missing the window
+		            through a corner region
+	and on the edges of a model, as Line objects, seen through the
+	window zoomed 1x, 4x and 16x into its middle (the further in, the
+	more edges cross the window's border).
+
+	Trivially accepted and rejected lines are decided by the outcodes
+	before any of the algorithms runs, so only straddling lines tell
+	them apart. Each timed run is a frame: AUTO picks its algorithm
+	from the lines of the run before.
+
+	cd trabalho-1
+	g++ -std=c++17 -O2 -march=native -pthread bench/bench_line_clip.cpp -o bench_line_clip `pkg-config --cflags --libs cairo`
+	./bench_line_clip [subzero.obj] [segments]
+*/
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <set>
+#include <string>
+#include <utility>
+#include <vector>
+#include "../Viewport.hpp"
+#include "../file_handler.hpp"
+
+struct Workload {
+	std::string name;
+	std::vector<Line*> lines;
+	std::vector<Coordinates> normalized; // what each line is clipped from
+};
+
+static const Line_clip_algs ALGS[] = {Line_clip_algs::CS, Line_clip_algs::LB, Line_clip_algs::NLN, Line_clip_algs::AUTO};
+static const char* ALG_NAMES[] = {"CS", "LB", "NLN", "AUTO"};
+
+static void add_line(Workload& w, const Coordinate& c0, const Coordinate& c1) {
+	Coordinates coords = {c0, c1};
+	w.lines.push_back(new Line("l", coords));
+	w.normalized.push_back(coords);
+}
+
+static bool inside(const Coordinate& c) {
+	return std::fabs(c[0]) <= 1 && std::fabs(c[1]) <= 1;
+}
+
+/* Both ends beyond the same window edge */
+static bool same_side(const Coordinate& a, const Coordinate& b) {
+	return (a[0] < -1 && b[0] < -1) || (a[0] > 1 && b[0] > 1)
+		|| (a[1] < -1 && b[1] < -1) || (a[1] > 1 && b[1] > 1);
+}
+
+static bool visible(const Coordinate& a, const Coordinate& b) {
+	Coordinates coords = {a, b};
+	Line line("l", coords);
+	line.set_normalized_coords(coords);
+	Clipping clipping(-1, 1, -1, 1);
+	clipping.set_line_clip_alg(Line_clip_algs::LB);
+	return clipping.clip(&line);
+}
+
+enum Kind { INSIDE, OUTSIDE, ONE_EDGE, ONE_END_IN, BOTH_OUT_HIT, BOTH_OUT_MISS, STRADDLING };
+
+static std::pair<Coordinate, Coordinate> segment(std::mt19937& rng, Kind kind) {
+	std::uniform_real_distribution<double> in(-1, 1), around(-3, 3), step(-0.3, 0.3);
+	if (kind == STRADDLING) {
+		Kind kinds[] = {ONE_EDGE, ONE_END_IN, BOTH_OUT_HIT, BOTH_OUT_MISS};
+		kind = kinds[rng() % 4];
+	}
+	while (true) {
+		Coordinate a(around(rng), around(rng)), b(around(rng), around(rng));
+		switch (kind) {
+			case INSIDE:
+				return {Coordinate(in(rng), in(rng)), Coordinate(in(rng), in(rng))};
+			case OUTSIDE:
+				if (same_side(a, b))
+					return {a, b};
+				break;
+			case ONE_EDGE:
+				a = Coordinate(in(rng), in(rng));
+				b = Coordinate(a[0] + step(rng), a[1] + step(rng));
+				if (!inside(b) && (std::fabs(b[0]) <= 1 || std::fabs(b[1]) <= 1))
+					return {a, b};
+				break;
+			case ONE_END_IN:
+				a = Coordinate(in(rng), in(rng));
+				if (!inside(b))
+					return {a, b};
+				break;
+			default:
+				if (!inside(a) && !inside(b) && !same_side(a, b) && visible(a, b) == (kind == BOTH_OUT_HIT))
+					return {a, b};
+				break;
+		}
+	}
+}
+
+/* n segments, fraction of them of kind main and the rest of kind rest */
+static Workload synthetic(const char* name, int n, Kind main, double fraction, Kind rest) {
+	std::mt19937 rng(7);
+	std::uniform_real_distribution<double> u(0, 1);
+	Workload w{name};
+	for (int i = 0; i < n; ++i) {
+		auto s = segment(rng, u(rng) < fraction ? main : rest);
+		add_line(w, s.first, s.second);
+	}
+	return w;
+}
+
+/* Every edge of the model's meshes once, fitted to the window and then
+   zoomed into its middle; normalized by the window, not divided */
+static Workload scene(const std::string& name, const std::vector<Object3D*>& meshes, double zoom) {
+	const double width = 510, height = 515;
+	BoundingBox box;
+	for (auto obj : meshes)
+		box.extend(obj->get_mesh().get_vertices());
+	double scale = std::min(width, height) / std::max(box.max[0] - box.min[0], box.max[1] - box.min[1]);
+	Coordinate center(box.center()[0], box.center()[1], box.min[2]);
+	Matrix fit = (Transformation::generate_translation_matrix(-center[0], -center[1], -center[2])
+		* Transformation::generate_scaling_matrix(scale, scale, scale)
+		* Transformation::generate_translation_matrix(width / 2, height / 2, 0)).get_transformation_matrix();
+
+	Window window(width, height);
+	window.zoom(width * (1 - 1 / zoom));
+	window.update_transformation();
+	Matrix m = fit * window.get_transformation().get_transformation_matrix();
+
+	Workload w{name + " " + std::to_string((int) zoom) + "x"};
+	for (auto obj : meshes) {
+		const auto &mesh = obj->get_mesh();
+		std::set<std::pair<int, int>> edges;
+		for (int f = 0; f < mesh.face_count(); ++f)
+			for (int k = 0; k < mesh.face_size(f); ++k) {
+				int a = mesh.face(f)[k], b = mesh.face(f)[(k + 1) % mesh.face_size(f)];
+				edges.insert({std::min(a, b), std::max(a, b)});
+			}
+		for (auto &e : edges) {
+			Coordinate a, b;
+			mat4_mul_vec(mesh.get_vertices()[e.first], m, a);
+			mat4_mul_vec(mesh.get_vertices()[e.second], m, b);
+			add_line(w, a, b);
+		}
+	}
+	return w;
+}
+
+/* Median time of clipping every line of w, once per run, and how many were kept */
+static double clip_ms(Workload& w, Line_clip_algs alg, int runs, int& kept) {
+	Clipping clipping(-1, 1, -1, 1);
+	clipping.set_line_clip_alg(alg);
+	std::vector<double> times;
+	for (int r = 0; r <= runs; ++r) {
+		for (std::size_t i = 0; i < w.lines.size(); ++i)
+			w.lines[i]->set_normalized_coords(w.normalized[i]);
+		clipping.next_frame();
+
+		kept = 0;
+		auto start = std::chrono::steady_clock::now();
+		for (auto line : w.lines)
+			kept += clipping.clip(line);
+		auto end = std::chrono::steady_clock::now();
+		// the first run only warms up (and gives AUTO a frame to go by)
+		if (r > 0)
+			times.push_back(std::chrono::duration<double, std::milli>(end - start).count());
+	}
+	std::sort(times.begin(), times.end());
+	return times[times.size()/2];
+}
+
+int main(int argc, char* argv[]) {
+	std::string file = argc > 1 ? argv[1] : "subzero.obj";
+	int n = argc > 2 ? std::atoi(argv[2]) : 200000;
+
+	std::vector<Workload> workloads;
+	workloads.push_back(synthetic("inside", n, INSIDE, 0.9, STRADDLING));
+	workloads.push_back(synthetic("outside", n, OUTSIDE, 0.9, STRADDLING));
+	workloads.push_back(synthetic("straddling", n, STRADDLING, 1, STRADDLING));
+	workloads.push_back(synthetic("one edge", n, ONE_EDGE, 1, ONE_EDGE));
+	workloads.push_back(synthetic("both out", n, BOTH_OUT_HIT, 0.5, BOTH_OUT_MISS));
+
+	try {
+		ObjReader reader(file);
+		std::vector<Object3D*> meshes;
+		for (auto obj : reader.getObjs())
+			if (obj->get_type() == obj_type::OBJECT_3D)
+				meshes.push_back((Object3D*) obj);
+		if (!meshes.empty())
+			for (double zoom : {1.0, 4.0, 16.0})
+				workloads.push_back(scene(file, meshes, zoom));
+	} catch (const char* e) {
+		std::fprintf(stderr, "%s: %s, only synthetic segments\n", file.c_str(), e);
+	}
+
+	std::printf("%-20s %8s %8s", "workload", "lines", "kept");
+	for (auto name : ALG_NAMES)
+		std::printf(" %10s", name);
+	std::printf("   (ms per frame)\n");
+	for (auto &w : workloads) {
+		int runs = std::max(5, (int) (2000000 / std::max<std::size_t>(1, w.lines.size())));
+		int kept = 0;
+		double ms[4];
+		for (int a = 0; a < 4; ++a)
+			ms[a] = clip_ms(w, ALGS[a], runs, kept);
+		std::printf("%-20s %8zu %8d", w.name.c_str(), w.lines.size(), kept);
+		for (double t : ms)
+			std::printf(" %10.3f", t);
+		std::printf("\n");
+	}
+	return 0;
+}
@@ -0,0 +1,155 @@
+/*
+	OBJ loader throughput: ObjReader (mmap + string_view tokenizer +
+	from_chars) against the std::getline/std::stringstream tokenizing it
+	replaced, on subzero.obj repeated scale times (1000 by default, about
+	470 MB) in a temporary file.
+
+	The old path is reproduced for the two directives that make up almost
+	all of the file, 'v' and 'f', and only tokenizes and stores what it
+	reads, so it is a lower bound on what the old loader cost. ObjReader
+	parses on one thread per core once the file is past a few MB, and
+	the last row reopens the file from the binary cache written next to
+	it by the previous row.
+
+	cd trabalho-1
+	g++ -std=c++17 -O2 -march=native -pthread bench/bench_obj_loader.cpp -o bench_obj_loader `pkg-config --cflags --libs cairo`
+	./bench_obj_loader [subzero.obj] [scale] [tmp file]
+*/
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include "../Viewport.hpp"
+#include "../file_handler.hpp"
+
+/* Copies of the same file need their face indices shifted to stay valid */
+static std::string shift_face(const std::string& line, int dv, int dvt, int dvn) {
+	std::stringstream in(line), out;
+	std::string token;
+	in >> token;
+	out << token;
+	while (in >> token) {
+		int shift[3] = {dv, dvt, dvn};
+		std::string shifted;
+		std::size_t start = 0;
+		for (int k = 0; start <= token.size(); ++k) {
+			std::size_t slash = token.find('/', start);
+			std::string part = token.substr(start, slash == std::string::npos ? std::string::npos : slash - start);
+			if (!part.empty() && part[0] != '-')
+				part = std::to_string(std::stoi(part) + shift[std::min(k, 2)]);
+			shifted += part;
+			if (slash == std::string::npos)
+				break;
+			shifted += '/';
+			start = slash + 1;
+		}
+		out << ' ' << shifted;
+	}
+	return out.str();
+}
+
+static std::size_t make_scaled(const std::string& src, const std::string& dst, int scale) {
+	std::ifstream in(src);
+	std::vector<std::string> lines;
+	int nv = 0, nvt = 0, nvn = 0;
+	for (std::string line; std::getline(in, line); ) {
+		if (line.compare(0, 2, "v ") == 0) ++nv;
+		else if (line.compare(0, 3, "vt ") == 0) ++nvt;
+		else if (line.compare(0, 3, "vn ") == 0) ++nvn;
+		lines.push_back(line);
+	}
+
+	std::ofstream out(dst);
+	for (int k = 0; k < scale; ++k)
+		for (const auto &line : lines) {
+			if (k > 0 && line.compare(0, 2, "f ") == 0)
+				out << shift_face(line, k*nv, k*nvt, k*nvn) << '\n';
+			else
+				out << line << '\n';
+		}
+	return out.tellp();
+}
+
+/* What loadObjs did per line before: getline, stringstream, operator>> */
+static std::size_t load_stringstream(const std::string& path) {
+	std::ifstream file(path);
+	Coordinates coords;
+	std::vector<int> indexes;
+	std::size_t faces = 0;
+	std::string tmp, keyWord, pointString;
+	while (std::getline(file, tmp)) {
+		if (tmp.size() <= 1) continue;
+		std::stringstream line(tmp);
+		line >> keyWord;
+		if (keyWord == "v") {
+			double x = 0, y = 0, z = 0;
+			line >> x >> y >> z;
+			coords.emplace_back(x, y, z);
+		} else if (keyWord == "f") {
+			indexes.clear();
+			while (line >> pointString) {
+				std::stringstream point(pointString);
+				int index = 0;
+				point >> index;
+				indexes.push_back(index < 0 ? coords.size() + index : index - 1);
+			}
+			++faces;
+		}
+	}
+	return faces + coords.size();
+}
+
+static std::size_t load_obj_reader(std::string path) {
+	ObjReader reader(path);
+	std::size_t n = 0;
+	for (auto obj : reader.getObjs()) {
+		n += obj->get_type() == obj_type::OBJECT_3D ? ((Object3D*) obj)->get_mesh().face_count() : 1;
+		delete obj;
+	}
+	return n;
+}
+
+template <typename F>
+static double time_s(F f) {
+	auto start = std::chrono::steady_clock::now();
+	f();
+	auto end = std::chrono::steady_clock::now();
+	return std::chrono::duration<double>(end - start).count();
+}
+
+int main(int argc, char* argv[]) {
+	std::string src = argc > 1 ? argv[1] : "subzero.obj";
+	int scale = argc > 2 ? std::atoi(argv[2]) : 1000;
+	std::string tmp = argc > 3 ? argv[3] : "/tmp/bench_obj_loader.obj";
+
+	std::size_t bytes = make_scaled(src, tmp, scale);
+	double mb = bytes / (1024.0 * 1024.0);
+	std::printf("%s x%d: %.1f MB, %u threads\n", src.c_str(), scale, mb,
+				std::max(1u, std::thread::hardware_concurrency()));
+
+	std::string cache = SceneCache::cachePath(tmp);
+
+	// first pass only warms the page cache
+	load_obj_reader(tmp);
+	std::remove(cache.c_str());
+
+	double old_s = time_s([&] { load_stringstream(tmp); });
+	std::printf("%-30s %8.3f s %10.1f MB/s\n", "getline + stringstream", old_s, mb / old_s);
+	std::fflush(stdout);
+
+	double new_s = time_s([&] { load_obj_reader(tmp); });
+	std::printf("%-30s %8.3f s %10.1f MB/s\n", "ObjReader (parse, write cache)", new_s, mb / new_s);
+	std::fflush(stdout);
+
+	double cache_s = time_s([&] { load_obj_reader(tmp); });
+	std::printf("%-30s %8.3f s %10.1f MB/s\n", "ObjReader (from cache)", cache_s, mb / cache_s);
+
+	std::remove(cache.c_str());
+	std::remove(tmp.c_str());
+	return 0;
+}
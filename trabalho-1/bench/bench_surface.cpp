@@ -0,0 +1,100 @@
+/*
+	Surface generation benchmark: BezierSurface and BSplineSurface on
+	square control grids of 1 to 256 patches, against evaluating every
+	sample on its own, twice (once for its curve of constant s, once for
+	its curve of constant t), with the basis functions recomputed for
+	each control point, as generateSurface did before.
+
+	cd trabalho-1
+	g++ -std=c++17 -O2 -march=native bench/bench_surface.cpp -o bench_surface
+	./bench_surface [max patches per side]
+*/
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+#include "../objects.hpp"
+
+template <typename F>
+static double median_ms(int runs, F f) {
+	std::vector<double> times;
+	for (int i = 0; i < runs; ++i) {
+		auto start = std::chrono::steady_clock::now();
+		f();
+		auto end = std::chrono::steady_clock::now();
+		times.push_back(std::chrono::duration<double, std::milli>(end - start).count());
+	}
+	std::sort(times.begin(), times.end());
+	return times[times.size()/2];
+}
+
+static Coordinates control_grid(int rows, int cols) {
+	Coordinates coords;
+	for (int i = 0; i < rows; ++i)
+		for (int j = 0; j < cols; ++j)
+			coords.emplace_back(j * 30, i * 25, 10 * std::sin(i * 0.7) * std::cos(j * 1.3));
+	return coords;
+}
+
+/* value of basis function i at t */
+static double blend(const Matrix& b, int i, double t) {
+	return ((b[0][i] * t + b[1][i]) * t + b[2][i]) * t + b[3][i];
+}
+
+static Coordinate sample(const Matrix& b, const Coordinates& coords, int cols, int row, int col, double s, double t) {
+	Coordinate p(0, 0, 0);
+	for (int axis = 0; axis < 3; ++axis)
+		for (int i = 0; i < 4; ++i)
+			for (int k = 0; k < 4; ++k)
+				p[axis] += blend(b, i, s) * blend(b, k, t) * coords[(row + i) * cols + col + k][axis];
+	return p;
+}
+
+/* The same curves as Surface::generatePatches, one sample at a time */
+static curve_list per_sample(const Matrix& b, int step, const Coordinates& coords, int rows, int cols, int n) {
+	curve_list curves;
+	std::string name = "curve";
+	for (int row = 0; row + 3 < rows; row += step)
+		for (int col = 0; col + 3 < cols; col += step) {
+			for (int i = 0; i <= n; ++i) {
+				Curve curve(name);
+				for (int j = 0; j <= n; ++j)
+					curve.add_coordinate(sample(b, coords, cols, row, col, (double) i / n, (double) j / n));
+				curves.push_back(std::move(curve));
+			}
+			for (int j = 0; j <= n; ++j) {
+				Curve curve(name);
+				for (int i = 0; i <= n; ++i)
+					curve.add_coordinate(sample(b, coords, cols, row, col, (double) i / n, (double) j / n));
+				curves.push_back(std::move(curve));
+			}
+		}
+	return curves;
+}
+
+int main(int argc, char* argv[]) {
+	int max_side = argc > 1 ? std::atoi(argv[1]) : 16;
+	const int n = 20; // m_step = 0.05
+
+	std::printf("%-8s %-8s %12s %12s %9s\n", "surface", "patches", "per sample", "patches", "speedup");
+	for (int side = 1; side <= max_side; side *= 2) {
+		int runs = side <= 4 ? 21 : 5;
+
+		// Bezier patches share their borders: 3 control points more per patch
+		int bezier = 3 * side + 1;
+		Coordinates coords = control_grid(bezier, bezier);
+		double before = median_ms(runs, [&] { per_sample(BezierCurve::basis_matrix(), 3, coords, bezier, bezier, n); });
+		double after = median_ms(runs, [&] { BezierSurface surface("s", bezier, bezier, coords); });
+		std::printf("%-8s %-8d %9.3f ms %9.3f ms %8.2fx\n", "bezier", side * side, before, after, before / after);
+
+		// B-spline patches overlap: 1 control point more per patch
+		int bspline = side + 3;
+		coords = control_grid(bspline, bspline);
+		before = median_ms(runs, [&] { per_sample(BsplineCurve::basis_matrix(), 1, coords, bspline, bspline, n); });
+		after = median_ms(runs, [&] { BSplineSurface surface("s", bspline, bspline, coords); });
+		std::printf("%-8s %-8d %9.3f ms %9.3f ms %8.2fx\n", "bspline", side * side, before, after, before / after);
+	}
+	return 0;
+}
@@ -0,0 +1,91 @@
+/*
+	Micro-benchmark of the window transform: the per-Coordinate path
+	(Object::set_normalized_coords) against the batched SoA kernel
+	(VertexBatch::transform) on subzero.obj replicated 1x, 10x and 100x.
+
+	cd trabalho-1
+	g++ -std=c++17 -O2 -march=native -pthread bench/bench_transform.cpp -o bench_transform `pkg-config --cflags --libs cairo`
+	./bench_transform [subzero.obj]
+*/
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <vector>
+#include "../Viewport.hpp"
+#include "../file_handler.hpp"
+
+template <typename F>
+static double median_ms(int runs, F f) {
+	std::vector<double> times;
+	for (int i = 0; i < runs; ++i) {
+		auto start = std::chrono::steady_clock::now();
+		f();
+		auto end = std::chrono::steady_clock::now();
+		times.push_back(std::chrono::duration<double, std::milli>(end - start).count());
+	}
+	std::sort(times.begin(), times.end());
+	return times[times.size()/2];
+}
+
+int main(int argc, char* argv[]) {
+	std::string file = argc > 1 ? argv[1] : "subzero.obj";
+	std::vector<Object3D> model;
+	try {
+		ObjReader r(file);
+		for (auto obj : r.getObjs()) {
+			if (obj->get_type() == obj_type::OBJECT_3D)
+				model.push_back(*(Object3D*) obj);
+			delete obj;
+		}
+	} catch (const char* e) {
+		std::printf("%s\n", e);
+		return 1;
+	}
+
+	Window window(510, 515);
+	window.rotate_x(20);
+	window.rotate_y(30);
+	window.update_transformation();
+	const Transformation& t = window.get_transformation();
+
+	std::printf("%6s %10s %14s %14s %16s %14s %14s\n",
+				"copies", "vertices", "per-coord ms", "batch ms", "batch+scatter ms",
+				"kernel speedup", "total speedup");
+
+	for (int copies : {1, 10, 100}) {
+		std::vector<Object3D> scene;
+		scene.reserve(model.size() * copies);
+		for (int i = 0; i < copies; ++i)
+			for (const auto &obj : model)
+				scene.push_back(obj);
+
+		VertexBatch world, normalized;
+		for (const auto &obj : scene)
+			obj.collect_coords(world);
+
+		int runs = copies == 100 ? 5 : 21;
+
+		double per_coord = median_ms(runs, [&] {
+			for (auto &obj : scene)
+				obj.set_normalized_coords(t);
+		});
+
+		double batch = median_ms(runs, [&] {
+			VertexBatch::transform(t.get_transformation_matrix(), world, normalized);
+		});
+
+		double batch_scatter = median_ms(runs, [&] {
+			VertexBatch::transform(t.get_transformation_matrix(), world, normalized);
+			std::size_t offset = 0;
+			for (auto &obj : scene) {
+				obj.scatter_normalized_coords(normalized, offset);
+				obj.build_normalized_faces(0, obj.get_mesh().face_count());
+			}
+		});
+
+		std::printf("%6d %10zu %14.3f %14.3f %16.3f %13.1fx %13.1fx\n",
+					copies, world.size(), per_coord, batch, batch_scatter,
+					per_coord / batch, per_coord / batch_scatter);
+	}
+	return 0;
+}
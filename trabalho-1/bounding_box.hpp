@@ -0,0 +1,52 @@
+#ifndef BOUNDING_BOX_HPP
+#define BOUNDING_BOX_HPP
+
+#include <limits>
+#include <algorithm>
+#include "coordinate.hpp"
+
+/* Axis aligned box around a set of world coords; empty until extended */
+struct BoundingBox {
+	Coordinate min, max;
+
+	BoundingBox() :
+		min(std::numeric_limits<double>::max(),
+			std::numeric_limits<double>::max(),
+			std::numeric_limits<double>::max()),
+		max(std::numeric_limits<double>::lowest(),
+			std::numeric_limits<double>::lowest(),
+			std::numeric_limits<double>::lowest())
+	{}
+
+	bool empty() const { return min[0] > max[0]; }
+
+	void extend(const Coordinate& c) {
+		for (int i = 0; i < 3; ++i) {
+			min[i] = std::min(min[i], c[i]);
+			max[i] = std::max(max[i], c[i]);
+		}
+	}
+
+	void extend(const Coordinates& coords) {
+		for (const auto &c : coords)
+			extend(c);
+	}
+
+	void extend(const BoundingBox& other) {
+		if (other.empty())
+			return;
+		extend(other.min);
+		extend(other.max);
+	}
+
+	Coordinate center() const {
+		return Coordinate((min[0] + max[0]) / 2, (min[1] + max[1]) / 2, (min[2] + max[2]) / 2);
+	}
+
+	/* i-th of the 8 corners, bit k of i picks min or max on axis k */
+	Coordinate corner(int i) const {
+		return Coordinate(i & 1 ? max[0] : min[0], i & 2 ? max[1] : min[1], i & 4 ? max[2] : min[2]);
+	}
+};
+
+#endif // BOUNDING_BOX_HPP
@@ -0,0 +1,162 @@
+#ifndef BVH_HPP
+#define BVH_HPP
+
+#include <vector>
+#include <algorithm>
+#include "coordinate.hpp"
+#include "bounding_box.hpp"
+
+/*
+	Bounding volume hierarchy over the world space boxes of the display
+	file objects, used to throw away whole groups of objects that fall
+	outside the normalized [-1,1] window before anything is clipped.
+
+	Items are referred to by their index in the boxes vector given to
+	build(). Each node covers a contiguous range of _items.
+*/
+class BVH {
+	public:
+		BVH() {}
+
+		void build(const std::vector<BoundingBox>& boxes);
+
+		/*
+			Walks the tree under the window matrix m, calling visible(i)
+			for every item that may show up on screen and culled(i) for
+			the others. A subtree that was already culled on the previous
+			call and still is gets skipped without calling anything, so
+			the cost follows what is visible, not the scene size.
+		*/
+		template <typename Visible, typename Culled>
+		void cull(const Matrix& m, Visible visible, Culled culled);
+
+	protected:
+	private:
+		enum Side { OUTSIDE, INSIDE, INTERSECT };
+
+		struct Node {
+			BoundingBox box;
+			int left = -1, right = -1; // children, -1 on leaves
+			int first = 0, count = 0;  // range in _items
+			bool culled = false;       // whole subtree culled last time
+		};
+
+		int build(int first, int count, const std::vector<BoundingBox>& boxes);
+		static Side classify(const BoundingBox& box, const Matrix& m);
+
+		std::vector<Node> _nodes;
+		std::vector<int> _items;
+		std::vector<std::pair<int, bool>> _stack; // (node, already known to be inside)
+
+		static const int LEAF_SIZE = 4;
+};
+
+void BVH::build(const std::vector<BoundingBox>& boxes) {
+	_nodes.clear();
+	_items.resize(boxes.size());
+	for (int i = 0; i < boxes.size(); ++i)
+		_items[i] = i;
+	if (!boxes.empty())
+		build(0, boxes.size(), boxes);
+}
+
+int BVH::build(int first, int count, const std::vector<BoundingBox>& boxes) {
+	int index = _nodes.size();
+	_nodes.emplace_back();
+
+	BoundingBox box, centers;
+	for (int i = first; i < first + count; ++i) {
+		box.extend(boxes[_items[i]]);
+		if (!boxes[_items[i]].empty())
+			centers.extend(boxes[_items[i]].center());
+	}
+	_nodes[index].box = box;
+	_nodes[index].first = first;
+	_nodes[index].count = count;
+
+	if (count <= LEAF_SIZE)
+		return index;
+
+	// median split along the axis where the centers spread the most
+	int axis = 0;
+	if (!centers.empty()) {
+		for (int k = 1; k < 3; ++k)
+			if (centers.max[k] - centers.min[k] > centers.max[axis] - centers.min[axis])
+				axis = k;
+	}
+	int half = count / 2;
+	std::nth_element(_items.begin() + first, _items.begin() + first + half, _items.begin() + first + count,
+		[&](int a, int b) { return boxes[a].center()[axis] < boxes[b].center()[axis]; });
+
+	int left = build(first, half, boxes);
+	int right = build(first + half, count - half, boxes);
+	_nodes[index].left = left;
+	_nodes[index].right = right;
+	return index;
+}
+
+BVH::Side BVH::classify(const BoundingBox& box, const Matrix& m) {
+	if (box.empty())
+		return INTERSECT;
+
+	double x_min = std::numeric_limits<double>::max(), y_min = x_min;
+	double x_max = std::numeric_limits<double>::lowest(), y_max = x_max;
+	for (int i = 0; i < 8; ++i) {
+		Coordinate c = box.corner(i);
+		Vec4 r;
+		mat4_mul_vec(c, m, r);
+		// a corner on or behind the eye: the projection of the box is
+		// not bounded by its corners any more, keep it
+		if (r[3] <= 1e-9)
+			return INTERSECT;
+		double x = r[0] / r[3], y = r[1] / r[3];
+		x_min = std::min(x_min, x);
+		x_max = std::max(x_max, x);
+		y_min = std::min(y_min, y);
+		y_max = std::max(y_max, y);
+	}
+
+	if (x_max < -1 || x_min > 1 || y_max < -1 || y_min > 1)
+		return OUTSIDE;
+	if (x_min >= -1 && x_max <= 1 && y_min >= -1 && y_max <= 1)
+		return INSIDE;
+	return INTERSECT;
+}
+
+template <typename Visible, typename Culled>
+void BVH::cull(const Matrix& m, Visible visible, Culled culled) {
+	if (_nodes.empty())
+		return;
+
+	auto &stack = _stack;
+	stack.clear();
+	stack.emplace_back(0, false);
+	while (!stack.empty()) {
+		Node& node = _nodes[stack.back().first];
+		bool inside = stack.back().second;
+		stack.pop_back();
+
+		Side side = inside ? INSIDE : classify(node.box, m);
+		if (side == OUTSIDE) {
+			if (!node.culled) {
+				for (int i = node.first; i < node.first + node.count; ++i)
+					culled(_items[i]);
+				node.culled = true;
+			}
+			continue;
+		}
+
+		// keep going down even when inside, so that no node below is
+		// left marked as culled while its items are visible
+		node.culled = false;
+		if (node.left < 0) {
+			for (int i = node.first; i < node.first + node.count; ++i)
+				visible(_items[i]);
+		} else {
+			stack.emplace_back(node.right, side == INSIDE);
+			stack.emplace_back(node.left, side == INSIDE);
+		}
+	}
+}
+
+#endif // BVH_HPP
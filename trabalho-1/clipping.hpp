@@ -1,9 +1,12 @@
 #ifndef CLIPPING_HPP
 #define CLIPPING_HPP
 
+#include <atomic>
 #include "objects.hpp"
+#include "frame_stats.hpp"
 
-enum class Line_clip_algs { CS, LB };
+/* AUTO picks CS or LB for each frame, see Clipping::next_frame */
+enum class Line_clip_algs { CS, LB, NLN, AUTO };
 
 class Clipping {
 	public:
@@ -20,36 +23,107 @@ class Clipping {
 			_alg = alg;
 		};
 
+		/*
+			Starts a frame: with AUTO, lines are clipped by the algorithm
+			that suited the lines of the last frame best. Only lines not
+			trivially accepted or rejected reach an algorithm, and of
+			those, the ones accepted through a single window edge (one
+			end inside, the other past one edge) are cut fastest by CS,
+			in one step; for the others, with both ends outside whether
+			they are accepted or rejected in the end, or leaving by a
+			corner, LB is faster, CS taking up to four steps. CS comes
+			out ahead overall from about 3 single-edge lines in 4
+			(bench/bench_line_clip.cpp).
+		*/
+		void next_frame();
+
+		/*
+			Normalized coords come in homogeneous, straight out of the
+			window matrix, and leave divided (w = 1): clipping is the only
+			place the perspective divide happens, and it only ever divides
+			what is in front of the near plane.
+		*/
 		bool clip(Object* obj);
+		/* Clips only faces [begin, end) of obj; true if any of them is visible */
+		bool clip_faces(Object3D* obj, int begin, int end);
+
+		/*
+			Outcodes of vertices [begin, end) of batch, normalized but not
+			divided, into codes[begin, end): 4 vertices per AVX compare,
+			one bit per plane, with no branches. Given them, clip only
+			looks at the vertices of primitives that straddle a plane;
+			codes are those of obj's vertices, in collect_coords order.
+		*/
+		void classify(const VertexBatch& batch, std::size_t begin, std::size_t end, unsigned char* codes) const;
+		bool clip(Object* obj, const unsigned char* codes);
+		bool clip_faces(Object3D* obj, int begin, int end, const unsigned char* codes);
+
+		/* Smallest w kept, i.e. the near plane is 1/100 of the focal
+		   distance in front of the eye; w is always 1 under a parallel view */
+		static constexpr double NEAR_W = 0.01;
 
 	protected:
 	private:
 		/* Methods */
-		bool clip_point(const Coordinate& c);
-		bool clip_line(Coordinate& c1, Coordinate& c2);
+		bool clip_point(Coordinate& c);
+		bool clip_point(Coordinate& c, int rc);
+		bool clip_line(Coordinate& c0, Coordinate& c1);
+		bool clip_line(Coordinate& c0, Coordinate& c1, int rc0, int rc1);
 		bool clip_polygon(Object* obj);
 
+		/* The same, after the divide: against the window only */
+		bool in_window(const Coordinate& c);
+		bool clip_line_2d(Coordinate& c0, Coordinate& c1);
+
 		int compute_coord_rc(const Coordinate& c);
+		int compute_clip_rc(const Coordinate& c) const;
 		bool cohen_sutherland_line_clip(Coordinate& c0, Coordinate& c1);
 		bool liang_basky_line_clip(Coordinate& c0, Coordinate& c1);
+		bool nicholl_lee_nicholl_line_clip(Coordinate& c0, Coordinate& c1);
+
+		static void divide(Coordinate& c);
+		static Coordinate near_crossing(const Coordinate& c0, const Coordinate& c1);
+		bool clip_near(Coordinates& coords);
+
+		/* Where one stage of the polygon clipper is in the polygon */
+		struct ClipStage {
+			Coordinate first, prev;
+			bool started = false;
+		};
+		static const int PLANES = 5;
+		/* The stages a polygon goes through: only the planes some of its
+		   vertices are outside of */
+		struct ClipPipeline {
+			ClipStage stages[PLANES];
+			int planes[PLANES];
+			int count = 0;
+		};
 
-		bool sutherland_hodgman_polygon_clip(Object* obj);
-		void clip_left(Coordinates& input, Coordinates& output);
-		void clip_right(Coordinates& input, Coordinates& output);
-		void clip_top(Coordinates& input, Coordinates& output);
-		void clip_bottom(Coordinates& input, Coordinates& output);
+		bool sutherland_hodgman_polygon_clip(Coordinates& coords);
+		/* all and any: AND and OR of the outcodes of coords */
+		bool sutherland_hodgman_polygon_clip(Coordinates& coords, int all, int any);
+		double plane_distance(int plane, const Coordinate& c);
+		void clip_vertex(ClipPipeline& p, int stage, const Coordinate& c, Coordinates& output);
+		void clip_edge(ClipPipeline& p, int stage, const Coordinate& c0, const Coordinate& c1, Coordinates& output);
 
 		bool clip_curve(Object* obj);
 
 		/* Attributes */
 		double _x_min, _x_max, _y_min, _y_max;
 		Line_clip_algs _alg = Line_clip_algs::CS;
+		// with AUTO: what this frame uses, and what the lines reaching it
+		// looked like, counted from the clip workers without a locked
+		// add (two such per line cost more than the choice saves); a
+		// few counts lost between workers don't change the ratio
+		Line_clip_algs _auto_alg = Line_clip_algs::LB;
+		std::atomic<unsigned long> _single_edge{0}, _straddling{0};
 		enum RC {	 	  	 	     	  		  	  	    	      	 	
 			INSIDE = 0,
 			LEFT = 1,
 			RIGHT = 2,
 			BOTTOM = 4,
-			TOP = 8
+			TOP = 8,
+			NEAR = 16
 		};
 };
 
@@ -71,15 +145,7 @@ bool Clipping::clip(Object* obj) {
 			return clip_curve(obj);
 		case obj_type::OBJECT_3D:
 			obj_3d = (Object3D*) obj;
-			draw = false;
-			for (auto &face : obj_3d->get_face_list()) {
-				bool tmp = clip_polygon(&face);
-				if (!tmp) {
-					face.get_normalized_coords().clear();
-				}
-				draw |= tmp;
-			}
-			return draw;
+			return clip_faces(obj_3d, 0, obj_3d->get_normalized_faces().size());
 		case obj_type::BEZIER_SURFACE:
 		case obj_type::BSPLINE_SURFACE:
 			surf = (Surface*) obj;
@@ -97,20 +163,187 @@ bool Clipping::clip(Object* obj) {
 	}	 	  	 	     	  		  	  	    	      	 	
 };
 
-bool Clipping::clip_point(const Coordinate& c) {
+bool Clipping::clip(Object* obj, const unsigned char* codes) {
+	Coordinates& coords = obj->get_normalized_coords();
+	int all = ~0, any = 0;
+	switch(obj->get_type()) {
+		case obj_type::POINT:
+			return clip_point(coords[0], codes[0]);
+		case obj_type::LINE:
+			return clip_line(coords[0], coords[1], codes[0], codes[1]);
+		case obj_type::POLYGON:
+			for (int i = 0; i < coords.size(); ++i) {
+				all &= codes[i];
+				any |= codes[i];
+			}
+			return sutherland_hodgman_polygon_clip(coords, all, any);
+		case obj_type::OBJECT_3D:
+			return clip_faces((Object3D*) obj, 0, ((Object3D*) obj)->get_normalized_faces().size(), codes);
+		default:
+			return clip(obj);
+	}
+};
+
+/* codes are per mesh vertex, so a vertex shared by several faces is
+   only classified once */
+bool Clipping::clip_faces(Object3D* obj, int begin, int end, const unsigned char* codes) {
+	auto &faces = obj->get_normalized_faces();
+	const auto &mesh = obj->get_mesh();
+	bool draw = false;
+	for (int f = begin; f < end; ++f) {
+		if (faces[f].empty()) {
+			FRAME_STATS_COUNT(BACKFACES, 1);
+			continue;
+		}
+		const int* idx = mesh.face(f);
+		int all = ~0, any = 0;
+		for (int k = 0; k < faces[f].size(); ++k) {
+			all &= codes[idx[k]];
+			any |= codes[idx[k]];
+		}
+		bool tmp = sutherland_hodgman_polygon_clip(faces[f], all, any);
+		if (!tmp) {
+			faces[f].clear();
+			FRAME_STATS_COUNT(CLIPPED, 1);
+		}
+		draw |= tmp;
+	}
+	return draw;
+};
+
+bool Clipping::clip_faces(Object3D* obj, int begin, int end) {
+	auto &faces = obj->get_normalized_faces();
+	bool draw = false;
+	for (int f = begin; f < end; ++f) {
+		// back-face culled while normalizing
+		if (faces[f].empty()) {
+			FRAME_STATS_COUNT(BACKFACES, 1);
+			continue;
+		}
+		bool tmp = sutherland_hodgman_polygon_clip(faces[f]);
+		if (!tmp) {
+			faces[f].clear();
+			FRAME_STATS_COUNT(CLIPPED, 1);
+		}
+		draw |= tmp;
+	}
+	return draw;
+};
+
+bool Clipping::clip_point(Coordinate& c) {
+	return clip_point(c, compute_clip_rc(c));
+};
+
+bool Clipping::clip_point(Coordinate& c, int rc) {
+	if (rc)
+		return false;
+	divide(c);
+	return true;
+};
+
+/*
+	Trivially rejected when both ends are outside the same plane, and
+	trivially accepted when neither is outside any; only a line that
+	reaches behind the near plane is cut in homogeneous coords, the
+	window edges are left to the 2D algorithm after the divide.
+*/
+bool Clipping::clip_line(Coordinate& c0, Coordinate& c1) {
+	return clip_line(c0, c1, compute_clip_rc(c0), compute_clip_rc(c1));
+};
+
+bool Clipping::clip_line(Coordinate& c0, Coordinate& c1, int rc0, int rc1) {
+	if (rc0 & rc1)
+		return false;
+	if (_alg == Line_clip_algs::AUTO && (rc0 | rc1)) {
+		int rc = rc0 | rc1;
+		if (!(rc0 && rc1) && !(rc & (rc - 1)) && rc != Clipping::RC::NEAR)
+			_single_edge.store(_single_edge.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+		_straddling.store(_straddling.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+	}
+
+	if (rc0 & Clipping::RC::NEAR)
+		c0 = near_crossing(c1, c0);
+	else if (rc1 & Clipping::RC::NEAR)
+		c1 = near_crossing(c0, c1);
+	divide(c0);
+	divide(c1);
+
+	if (!(rc0 | rc1))
+		return true;
+	return clip_line_2d(c0, c1);
+};
+
+bool Clipping::clip_polygon(Object* obj) {
+	return sutherland_hodgman_polygon_clip(obj->get_normalized_coords());
+};
+
+bool Clipping::in_window(const Coordinate& c) {
 	return ((c[0] >= _x_min) && (c[0] <= _x_max)
 		&& (c[1] >= _y_min) && (c[1] <= _y_max));
 };
 
-bool Clipping::clip_line(Coordinate& c0, Coordinate& c1) {
-	if (_alg == Line_clip_algs::CS)
+void Clipping::next_frame() {
+	unsigned long single_edge = _single_edge.exchange(0, std::memory_order_relaxed);
+	unsigned long straddling = _straddling.exchange(0, std::memory_order_relaxed);
+	// no straddling lines last frame: nothing new to go by
+	if (straddling > 0)
+		_auto_alg = 4 * single_edge >= 3 * straddling ? Line_clip_algs::CS : Line_clip_algs::LB;
+};
+
+bool Clipping::clip_line_2d(Coordinate& c0, Coordinate& c1) {
+	Line_clip_algs alg = _alg == Line_clip_algs::AUTO ? _auto_alg : _alg;
+	if (alg == Line_clip_algs::CS)
 		return  cohen_sutherland_line_clip(c0,c1);
-	else
+	else if (alg == Line_clip_algs::LB)
 		return liang_basky_line_clip(c0,c1);
+	else
+		return nicholl_lee_nicholl_line_clip(c0,c1);
 };
 
-bool Clipping::clip_polygon(Object* obj) {
-	return sutherland_hodgman_polygon_clip(obj);
+/* Back to w = 1, only ever called with w >= NEAR_W */
+void Clipping::divide(Coordinate& c) {
+	double w = c[3];
+	if (w == 1)
+		return;
+	c[0] /= w;
+	c[1] /= w;
+	c[2] /= w;
+	c[3] = 1;
+};
+
+/* Where inside -> outside crosses the near plane, all four coords
+   interpolated (z too, for the z-buffer) */
+Coordinate Clipping::near_crossing(const Coordinate& inside, const Coordinate& outside) {
+	double t = (inside[3] - NEAR_W) / (inside[3] - outside[3]);
+	Coordinate c;
+	for (int i = 0; i < 4; ++i)
+		c[i] = inside[i] + t * (outside[i] - inside[i]);
+	c[3] = NEAR_W;
+	return c;
+};
+
+/* Cuts a polyline where it goes behind the near plane, keeping it
+   joined like clip_curve does at the window edges, then divides it */
+bool Clipping::clip_near(Coordinates& coords) {
+	bool behind = false;
+	for (const auto &c : coords)
+		behind |= c[3] < NEAR_W;
+
+	if (behind) {
+		static thread_local Coordinates front;
+		front.clear();
+		for (int i = 0; i < coords.size(); ++i) {
+			bool in = coords[i][3] >= NEAR_W;
+			if (i > 0 && in != (coords[i-1][3] >= NEAR_W))
+				front.push_back(in ? near_crossing(coords[i], coords[i-1]) : near_crossing(coords[i-1], coords[i]));
+			if (in)
+				front.push_back(coords[i]);
+		}
+		coords.swap(front);
+	}
+	for (auto &c : coords)
+		divide(c);
+	return coords.size() > 0;
 };
 
 int Clipping::compute_coord_rc(const Coordinate& c) {
@@ -129,9 +362,69 @@ int Clipping::compute_coord_rc(const Coordinate& c) {
 	return rc;
 };
 
+/* compute_coord_rc before the divide: x/w < x_min is x < x_min * w while
+   w > 0, and a plane all the vertices are outside of still rejects them
+   whatever their w, the window and near planes being half-spaces of the
+   homogeneous coords too. Behind the eye a vertex can be outside both
+   LEFT and RIGHT (or BOTTOM and TOP); both bits are then set, as
+   classify does */
+int Clipping::compute_clip_rc(const Coordinate& c) const {
+	double w = c[3];
+	int rc = w < NEAR_W ? Clipping::RC::NEAR : Clipping::RC::INSIDE;
+
+	if (c[0] < _x_min * w)
+		rc |= Clipping::RC::LEFT;
+	if (c[0] > _x_max * w)
+		rc |= Clipping::RC::RIGHT;
+
+	if (c[1] < _y_min * w)
+		rc |= Clipping::RC::BOTTOM;
+	if (c[1] > _y_max * w)
+		rc |= Clipping::RC::TOP;
+
+	return rc;
+};
+
+void Clipping::classify(const VertexBatch& batch, std::size_t begin, std::size_t end, unsigned char* codes) const {
+	const double *x = batch.x(), *y = batch.y(), *w = batch.w();
+	std::size_t i = begin;
+
+#if defined(__AVX__)
+	__m256d x_min = _mm256_set1_pd(_x_min), x_max = _mm256_set1_pd(_x_max);
+	__m256d y_min = _mm256_set1_pd(_y_min), y_max = _mm256_set1_pd(_y_max);
+	__m256d near_w = _mm256_set1_pd(NEAR_W);
+	// each compare leaves all ones in the lanes outside its plane; keeping
+	// only that plane's bit of them and or-ing the planes gives 4 outcodes
+#define CLIP_BIT(cmp, rc) _mm256_and_pd(cmp, _mm256_castsi256_pd(_mm256_set1_epi64x(rc)))
+	alignas(32) long long rc[4];
+	for (; i + 4 <= end; i += 4) {
+		__m256d vx = _mm256_loadu_pd(x + i);
+		__m256d vy = _mm256_loadu_pd(y + i);
+		__m256d vw = _mm256_loadu_pd(w + i);
+
+		__m256d left   = CLIP_BIT(_mm256_cmp_pd(vx, _mm256_mul_pd(x_min, vw), _CMP_LT_OQ), Clipping::RC::LEFT);
+		__m256d right  = CLIP_BIT(_mm256_cmp_pd(vx, _mm256_mul_pd(x_max, vw), _CMP_GT_OQ), Clipping::RC::RIGHT);
+		__m256d bottom = CLIP_BIT(_mm256_cmp_pd(vy, _mm256_mul_pd(y_min, vw), _CMP_LT_OQ), Clipping::RC::BOTTOM);
+		__m256d top    = CLIP_BIT(_mm256_cmp_pd(vy, _mm256_mul_pd(y_max, vw), _CMP_GT_OQ), Clipping::RC::TOP);
+		__m256d behind = CLIP_BIT(_mm256_cmp_pd(vw, near_w, _CMP_LT_OQ), Clipping::RC::NEAR);
+
+		_mm256_store_pd((double*) rc, _mm256_or_pd(_mm256_or_pd(_mm256_or_pd(left, right), _mm256_or_pd(bottom, top)), behind));
+		codes[i]     = rc[0];
+		codes[i + 1] = rc[1];
+		codes[i + 2] = rc[2];
+		codes[i + 3] = rc[3];
+	}
+#undef CLIP_BIT
+#endif
+
+	// scalar fallback and tail
+	for (; i < end; ++i)
+		codes[i] = compute_clip_rc(Vec4{ {x[i], y[i], 0, w[i]} });
+};
+
 bool Clipping::cohen_sutherland_line_clip(Coordinate& c0, Coordinate& c1) {
 	if (c0 == c1)
-		return clip_point(c0);
+		return in_window(c0);
 
 	int rc0 = compute_coord_rc(c0);
 	int rc1 = compute_coord_rc(c1);
@@ -175,7 +468,7 @@ bool Clipping::cohen_sutherland_line_clip(Coordinate& c0, Coordinate& c1) {
 
 bool Clipping::liang_basky_line_clip(Coordinate& c0, Coordinate& c1) {	 	  	 	     	  		  	  	    	      	 	
 	if (c0 == c1)
-		return clip_point(c0);
+		return in_window(c0);
 
 	auto delta = c1 - c0;
 	double p, q, r;
@@ -230,176 +523,226 @@ bool Clipping::liang_basky_line_clip(Coordinate& c0, Coordinate& c1) {
 	return true;
 };
 
-bool Clipping::sutherland_hodgman_polygon_clip(Object* obj) {
-	auto input = obj->get_normalized_coords();
-	Coordinates tmp;
-	Coordinates output;
-
-	clip_left(input, tmp);
-	clip_right(tmp, output);
-	clip_top(output, tmp);
-	clip_bottom(tmp, output);
+/*
+	Nicholl-Lee-Nicholl: the line and the window are reflected (and
+	transposed) until the end outside the window, c0 if both are, lies
+	left of the window or below and left of it. Which side of the rays
+	from there to the window corners the line passes then says which
+	edges it enters and leaves by, so no point is classified twice and
+	at most two intersections are computed, each against a known edge.
+*/
+bool Clipping::nicholl_lee_nicholl_line_clip(Coordinate& c0, Coordinate& c1) {
+	if (c0 == c1)
+		return in_window(c0);
 
-	if (output.size() == 0)
+	int rc0 = compute_coord_rc(c0);
+	int rc1 = compute_coord_rc(c1);
+	if (!(rc0 | rc1))
+		return true;
+	if (rc0 & rc1)
 		return false;
 
-	obj->set_normalized_coords(output);
-	return true;
-};
+	bool swap = rc0 == Clipping::RC::INSIDE;
+	Coordinate& p = swap ? c1 : c0;
+	Coordinate& q = swap ? c0 : c1;
+	bool q_inside = (swap ? rc0 : rc1) == Clipping::RC::INSIDE;
+
+	double x0 = p[0], y0 = p[1], x1 = q[0], y1 = q[1];
+	double l = _x_min, r = _x_max, b = _y_min, t = _y_max;
+	bool flip_x = x0 > r, flip_y = y0 > t;
+	if (flip_x) {
+		x0 = -x0; x1 = -x1;
+		std::swap(l, r); l = -l; r = -r;
+	}
+	if (flip_y) {
+		y0 = -y0; y1 = -y1;
+		std::swap(b, t); b = -b; t = -t;
+	}
+	// below the window, but not left of it
+	bool transpose = x0 >= l;
+	if (transpose) {
+		std::swap(x0, y0); std::swap(x1, y1);
+		std::swap(l, b); std::swap(r, t);
+	}
 
-void Clipping::clip_left(Coordinates& input, Coordinates& output) {	 	  	 	     	  		  	  	    	      	 	
-	if (output.size() > 0)
-		output.clear();
-	if (input.size() == 0)
-		return;
+	// q is neither left of nor (from the corner) below the window, as
+	// the outcodes had nothing in common: dx > 0, and dy > 0 from the corner
+	double dx = x1 - x0, dy = y1 - y0;
+	// > 0 when the line passes counterclockwise of the ray to (x, y)
+	auto side = [&](double x, double y) { return (x - x0) * dy - (y - y0) * dx; };
+	bool corner = y0 < b;
+	if (side(l, t) > 0 || (corner ? side(r, b) : side(l, b)) < 0)
+		return false;
 
-	double clip_x = _x_min;
-	input.push_back(input[0]);
-	for (unsigned int i = 0; i < input.size()-1; i++) {
-		Coordinate c0 = input[i];
-		Coordinate c1 = input[i+1];
-
-		//Caso 1: out -> out
-		if (c0[0] < clip_x && c1[0] < clip_x) {}
-		//Case 2: in -> in
-		if (c0[0] >= clip_x && c1[0] >= clip_x)
-			output.push_back(c1);
-
-		double x = clip_x;
-		double m = (c1[1]-c0[1])/(c1[0]-c0[0]);
-		double y = m * (x - c0[0]) + c0[1];
-
-		//Caso 3: in -> out
-		if (c0[0] >= clip_x && c1[0] < clip_x)
-			output.emplace_back(x,y);
-		//Caso 4: out -> in
-		if (c0[0] < clip_x && c1[0] >= clip_x) {
-			output.emplace_back(x,y);
-			output.push_back(c1);
-		}
+	double px, py;
+	if (!corner || side(l, b) > 0) {
+		px = l;
+		py = y0 + dy * (l - x0) / dx;
+	} else {
+		px = x0 + dx * (b - y0) / dy;
+		py = b;
 	}
-};
 
-void Clipping::clip_right(Coordinates& input, Coordinates& output) {
-	if (output.size() > 0)
-		output.clear();
-	if (input.size() == 0)
-		return;
-
-	double clip_x = _x_max;
-	input.push_back(input[0]);
-	for (unsigned int i = 0; i < input.size()-1; i++) {	 	  	 	     	  		  	  	    	      	 	
-		Coordinate c0 = input[i];
-		Coordinate c1 = input[i+1];
-
-		//Caso 1: out -> out
-		if (c0[0] >= clip_x && c1[0] >= clip_x) {}
-		//Caso 2: in -> in
-		if (c0[0] < clip_x && c1[0] < clip_x)
-			output.push_back(c1);
-
-		double x = clip_x;
-		double m = (c1[1]-c0[1])/(c1[0]-c0[0]);
-		double y = m * (x-c0[0]) + c0[1];
-
-		//Caso 3: in -> out
-		if (c0[0] < clip_x && c1[0] >= clip_x)
-			output.emplace_back(x,y);
-		//Caso 4: out -> in
-		if (c0[0] >= clip_x && c1[0] < clip_x) {
-			output.emplace_back(x,y);
-			output.push_back(c1);
+	double qx = x1, qy = y1;
+	if (!q_inside) {
+		if (side(r, t) > 0) {
+			qx = x0 + dx * (t - y0) / dy;
+			qy = t;
+		} else if (!corner && side(r, b) < 0) {
+			qx = x0 + dx * (b - y0) / dy;
+			qy = b;
+		} else {
+			qx = r;
+			qy = y0 + dy * (r - x0) / dx;
 		}
 	}
-};
-
-void Clipping::clip_top(Coordinates& input, Coordinates& output) {
-	if(output.size() > 0)
-		output.clear();
-	if(input.size() == 0)
-		return;
 
-	double clip_y = _y_max;
-	input.push_back(input[0]);
-	for (unsigned int i = 0; i < input.size()-1; i++) {
-		Coordinate c0 = input[i];
-		Coordinate c1 = input[i+1];
+	if (transpose) {
+		std::swap(px, py);
+		std::swap(qx, qy);
+	}
+	if (flip_y) {
+		py = -py;
+		qy = -qy;
+	}
+	if (flip_x) {
+		px = -px;
+		qx = -qx;
+	}
+	p[0] = px;
+	p[1] = py;
+	q[0] = qx;
+	q[1] = qy;
+	return true;
+};
 
-		//Caso 1: out -> out
-		if(c0[1] > clip_y && c1[1] > clip_y) {}	 	  	 	     	  		  	  	    	      	 	
+/*
+	Polygons are classified first by their vertices' outcodes: all of
+	them outside one plane rejects the polygon, none outside any accepts
+	it as it is. Otherwise only the stages for the planes it crosses
+	(near, left, right, top, bottom, in this order) run, as one
+	pipeline: each vertex goes through clip_vertex, and whatever a stage
+	emits goes straight on to the next one, so no stage needs a buffer
+	of its own. The vertices coming out of the last stage are collected
+	in a per-thread buffer that is swapped with coords, and the old
+	coords buffer is reused by the next polygon this thread clips.
+	Everything happens before the divide, which is left for the end.
+*/
+bool Clipping::sutherland_hodgman_polygon_clip(Coordinates& coords) {
+	int all = ~0, any = 0;
+	for (const auto &c : coords) {
+		int rc = compute_clip_rc(c);
+		all &= rc;
+		any |= rc;
+	}
+	return sutherland_hodgman_polygon_clip(coords, all, any);
+};
 
-		//Caso 2: in -> in
-		if(c0[1] <= clip_y && c1[1] <= clip_y)
-			output.push_back(c1);
+bool Clipping::sutherland_hodgman_polygon_clip(Coordinates& coords, int all, int any) {
+	if (coords.size() == 0 || all)
+		return false;
 
-		double y = clip_y;
-		double m = (c1[0]-c0[0])/(c1[1]-c0[1]);
-		double x = m * (y-c0[1]) + c0[0];
+	if (any) {
+		static const int plane_rc[PLANES] = {Clipping::RC::NEAR, Clipping::RC::LEFT,
+			Clipping::RC::RIGHT, Clipping::RC::TOP, Clipping::RC::BOTTOM};
+		// behind the eye the side outcodes are mirrored: what the near
+		// plane cuts off may leave through any side
+		if (any & Clipping::RC::NEAR)
+			any = ~0;
+		ClipPipeline p;
+		for (int plane = 0; plane < PLANES; ++plane)
+			if (any & plane_rc[plane])
+				p.planes[p.count++] = plane;
+
+		static thread_local Coordinates output;
+		output.clear();
+		for (const auto &c : coords)
+			clip_vertex(p, 0, c, output);
+		// each stage closes its polygon, which may still feed the next ones
+		for (int stage = 0; stage < p.count; ++stage)
+			if (p.stages[stage].started)
+				clip_edge(p, stage, p.stages[stage].prev, p.stages[stage].first, output);
+
+		if (output.size() == 0)
+			return false;
+		coords.swap(output);
+	}
 
-		//Caso 3: in -> out
-		if(c0[1] <= clip_y && c1[1] > clip_y)
-			output.emplace_back(x,y);
+	for (auto &c : coords)
+		divide(c);
+	return true;
+};
 
-		//Caso 4: out -> in
-		if(c0[1] > clip_y && c1[1] <= clip_y){
-			output.emplace_back(x,y);
-			output.push_back(c1);
-		}
+/* Signed distance of c to a plane, positive inside; in homogeneous
+   coords, so it is linear along any edge */
+double Clipping::plane_distance(int plane, const Coordinate& c) {
+	switch (plane) {
+		case 0: return c[3] - NEAR_W;
+		case 1: return c[0] - _x_min * c[3];
+		case 2: return _x_max * c[3] - c[0];
+		case 3: return _y_max * c[3] - c[1];
+		default: return c[1] - _y_min * c[3];
 	}
 };
 
-void Clipping::clip_bottom(Coordinates& input, Coordinates& output) {
-	if(output.size() > 0)
-		output.clear();
-	if(input.size() == 0)
+void Clipping::clip_vertex(ClipPipeline& p, int stage, const Coordinate& c, Coordinates& output) {
+	if (stage == p.count) {
+		output.push_back(c);
 		return;
+	}
+	ClipStage& s = p.stages[stage];
+	if (!s.started) {
+		s.first = c;
+		s.prev = c;
+		s.started = true;
+		return;
+	}
+	clip_edge(p, stage, s.prev, c, output);
+	s.prev = c;
+};
 
-	double clip_y = _y_min;
-	input.push_back(input[0]);
-	for(unsigned int i = 0; i < input.size()-1; i++) {
-		Coordinate c0 = input[i];
-		Coordinate c1 = input[i+1];
-
-		//Caso 1: out -> out
-		if(c0[1] < clip_y && c1[1] < clip_y) {}
-
-		//Caso 2: in -> in
-		if(c0[1] >= clip_y && c1[1] >= clip_y)
-			output.push_back(c1);
-
-		double y = clip_y;
-		double m = (c1[0]-c0[0])/(c1[1]-c0[1]);
-		double x = m * (y-c0[1]) + c0[0];
-
-		//Caso 3: in -> out
-		if(c0[1] >= clip_y && c1[1] < clip_y)
-			output.emplace_back(x,y);
-
-		//Caso 4: out -> in
-		if(c0[1] < clip_y && c1[1] >= clip_y){	 	  	 	     	  		  	  	    	      	 	
-			output.emplace_back(x,y);
-			output.push_back(c1);
-		}
+/* c0 -> c1 against one plane: the crossing point, if the edge crosses
+   it, then c1 if it is inside */
+void Clipping::clip_edge(ClipPipeline& p, int stage, const Coordinate& c0, const Coordinate& c1, Coordinates& output) {
+	int plane = p.planes[stage];
+	double d0 = plane_distance(plane, c0), d1 = plane_distance(plane, c1);
+	// the right edge itself is outside, as it always was
+	bool in0 = plane == 2 ? d0 > 0 : d0 >= 0;
+	bool in1 = plane == 2 ? d1 > 0 : d1 >= 0;
+
+	if (in0 != in1) {
+		double t = d0 / (d0 - d1);
+		Coordinate c;
+		for (int i = 0; i < 4; ++i)
+			c[i] = c0[i] + t * (c1[i] - c0[i]);
+		clip_vertex(p, stage + 1, c, output);
 	}
+	if (in1)
+		clip_vertex(p, stage + 1, c1, output);
 };
 
 bool Clipping::clip_curve(Object* obj) {
 	Coordinates& coords = obj->get_normalized_coords();
-	Coordinates new_curve;
+	if (!clip_near(coords))
+		return false;
+
+	// swapped in below, like the polygon clipper's output
+	static thread_local Coordinates new_curve;
+	new_curve.clear();
 	bool prev_inside = true;
 	Coordinate prev(2);
 
 	for (int i = 0; i < coords.size(); i++) {
-		if (clip_point(coords[i])) {
+		if (in_window(coords[i])) {
 			if (!prev_inside) {
-				clip_line(prev, coords[i]);
+				clip_line_2d(prev, coords[i]);
 				new_curve.push_back(prev);
 			}
 			new_curve.push_back(coords[i]);
 			prev_inside = true;
 		} else {
 			if (prev_inside && new_curve.size() != 0) {
-				clip_line(prev, coords[i]);
+				clip_line_2d(prev, coords[i]);
 				new_curve.push_back(coords[i]);
 			}
 			prev_inside = false;
@@ -409,7 +752,7 @@ bool Clipping::clip_curve(Object* obj) {
 	if (new_curve.size() == 0)
 		return false;
 
-	obj->set_normalized_coords(new_curve);
+	coords.swap(new_curve);
 	return true;
 };
 
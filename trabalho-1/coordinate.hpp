@@ -5,47 +5,26 @@
 #include <vector>
 #include <stdexcept>
 #include <iostream>
+#include "mat4.hpp"
 
-typedef std::vector<std::vector<double>> Matrix;
+typedef Mat4 Matrix;
 
-class Coordinate: public std::vector<double> {
+class Coordinate: public Vec4 {
 	public:
- 		Coordinate(int n=3) {
- 			for (int i = 0; i < 3; i++)
- 				this->push_back(0);
- 			this->push_back(1);
- 		}
+ 		Coordinate(int n=3) : Vec4{ {0, 0, 0, 1} } {}
 
- 		Coordinate(double x, double y, double z = 0) {
- 			this->push_back(x);
- 			this->push_back(y);
- 			this->push_back(z);
- 			this->push_back(1);
- 		}
+ 		Coordinate(double x, double y, double z = 0) : Vec4{ {x, y, z, 1} } {}
 
- 		void transform(Matrix& m) {
- 			if (m.size() != this->size()) {
- 				throw "dimensional error";
- 			}
- 			std::vector<double> res;
- 			for (int i = 0; i < this->size(); ++i) {
- 				double sum = 0;
- 				for (int j = 0; j < m.size(); ++j) {
- 					sum += this->at(j) * m[j][i];
- 				}
- 				res.push_back(sum);
- 			} 	  	 	     	  		  	  	    	      	 	
- 			for (int i = 0; i < res.size(); ++i) {
- 				// bringing back to w = 1;
- 				this->at(i) = res[i]/res[3];
- 			}
+ 		Coordinate(const Vec4& v) : Vec4(v) {}
+
+ 		void transform(const Matrix& m) {
+ 			// bringing back to w = 1;
+ 			mat4_mul_vec_project(*this, m, *this); 	  	 	     	  		  	  	    	      	 	
  		}
 
  		Coordinate& operator+=(const Coordinate& other) {
- 			if (this->size() != other.size())
- 				throw std::out_of_range("Different dimensions coodinates");
             for (int i = 0; i < this->size()-1; ++i)
-                this->at(i) = this->at(i) + other[i];
+                v[i] += other[i];
             return *this;
  		};
  		
@@ -55,10 +34,8 @@ class Coordinate: public std::vector<double> {
  		};
 
  		Coordinate& operator-=(const Coordinate& other) {
- 			if (this->size() != other.size())
- 				throw std::out_of_range("Different dimensions coodinates");
             for (int i = 0; i < this->size()-1; ++i)
-                this->at(i) = this->at(i) - other[i];
+                v[i] -= other[i];
             return *this;
  		};
  		
@@ -67,11 +44,9 @@ class Coordinate: public std::vector<double> {
  			return lhs;
  		};
 
-		bool operator==(const Coordinate& other) {
-			if (this->size() != other.size())
-				return false;
+		bool operator==(const Coordinate& other) const {
 			for (int i = 0; i < this->size(); ++i) {
-				if (this->at(i) != other[i])
+				if (v[i] != other[i])
 					return false;
 			}	 	  	 	     	  		  	  	    	      	 	
 			return true;
@@ -86,9 +61,10 @@ class Coordinate: public std::vector<double> {
 			return os;
 		};
 
- 		virtual ~Coordinate() {};
  	protected:
  	private:
 };
 
+typedef std::vector<Coordinate> Coordinates;
+
 #endif
@@ -0,0 +1,79 @@
+#ifndef DISPLAY_FILE_HPP
+#define DISPLAY_FILE_HPP
+
+#include <vector>
+#include <stdexcept>
+#include "objects.hpp"
+
+typedef unsigned int ObjectHandle;
+
+/*
+	Display file stored as a dense array of objects, so drawing and
+	normalizing walk contiguous memory and indexed access is O(1).
+
+	Objects are also reachable by a handle (the tree view keeps handles,
+	not positions). Handles are never reused; _slots maps each handle to
+	the position of its object in _objects, or -1 once cleared. Objects
+	are never removed one by one: Viewport keeps its batches, tasks and
+	culling results by position, so nothing may move within the array.
+
+	The display file owns its objects.
+*/
+class DisplayFile {
+	public:
+		DisplayFile() {}
+		DisplayFile(const DisplayFile&) = delete;
+		DisplayFile& operator=(const DisplayFile&) = delete;
+
+		~DisplayFile() {
+			clear();
+		}
+
+		ObjectHandle add(Object* obj);
+		void clear();
+
+		bool contains(ObjectHandle handle) const {
+			return handle < _slots.size() && _slots[handle] >= 0;
+		}
+
+		Object* get(ObjectHandle handle) const;
+
+		/* Position based access, for iteration in draw order */
+		Object* operator[](int i) const { return _objects[i]; }
+		ObjectHandle handle_at(int i) const { return _handles[i]; }
+		int size() const { return _objects.size(); }
+
+		std::vector<Object*>::const_iterator begin() const { return _objects.begin(); }
+		std::vector<Object*>::const_iterator end() const { return _objects.end(); }
+
+	protected:
+	private:
+		std::vector<Object*> _objects;
+		std::vector<ObjectHandle> _handles; // position -> handle
+		std::vector<int> _slots;            // handle -> position
+};
+
+ObjectHandle DisplayFile::add(Object* obj) {
+	ObjectHandle handle = _slots.size();
+	_slots.push_back(_objects.size());
+	_objects.push_back(obj);
+	_handles.push_back(handle);
+	return handle;
+}
+
+void DisplayFile::clear() {
+	for (auto obj : _objects)
+		delete obj;
+	_objects.clear();
+	_handles.clear();
+	for (auto &slot : _slots)
+		slot = -1;
+}
+
+Object* DisplayFile::get(ObjectHandle handle) const {
+	if (!contains(handle))
+		throw std::out_of_range("invalid object handle");
+	return _objects[_slots[handle]];
+}
+
+#endif // DISPLAY_FILE_HPP
@@ -7,6 +7,20 @@
 #include <regex>
 #include <map>
 #include <string>
+#include <string_view>
+#include <charconv>
+#include <cstring>
+#include <cstdint>
+#include <cstdio>
+#include <thread>
+#include <algorithm>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "worker_pool.hpp"
 
 /*
     Possiveis Diretivas:
@@ -23,6 +37,9 @@
 
         Pode-se usar '\' na declaração dos vertices
          dos objetos.
+
+        Depois de lido, um .obj ganha um cache
+         binario na mesma pasta (ver SceneCache).
 */
 
 // class ColorReader
@@ -61,6 +78,87 @@
 //         int m_numColors = 0;
 // };
 
+// Arquivo inteiro mapeado na memoria, somente leitura.
+//  Evita copiar o arquivo para buffers do stream
+class MappedFile
+{
+    public:
+        MappedFile(const std::string& filename);
+        ~MappedFile();
+
+        MappedFile(const MappedFile&) = delete;
+        MappedFile& operator=(const MappedFile&) = delete;
+
+        bool is_open() const { return m_fd >= 0; }
+        const char* data() const { return m_data; }
+        std::size_t size() const { return m_size; }
+        // Data de modificacao, em nanossegundos
+        std::int64_t mtime() const { return m_mtime; }
+
+    private:
+        int m_fd = -1;
+        const char* m_data = nullptr;
+        std::size_t m_size = 0;
+        std::int64_t m_mtime = 0;
+};
+
+// Cache binario da cena lida de um .obj, salvo ao lado dele
+//  (arquivo.obj.cache). Quando o .obj for aberto de novo os
+//  objetos sao montados direto do cache mapeado na memoria,
+//  sem ler texto. O cache so vale enquanto o tamanho, a data
+//  de modificacao e o hash do .obj forem os mesmos.
+//
+//  Formato (versao 1, na ordem de bytes da maquina):
+//      Header
+//      Entry[numObjects]       tipo, nome e faixas de cada objeto
+//      double[3*numVertices]   x y z dos vertices
+//      int32[numIndices]       vertices das faces, relativos ao objeto
+//      int32[numFaces]         numero de vertices de cada face
+//      uint8[numFaces]         face preenchida ou nao
+//      char[namesSize]         nomes dos objetos, sem '\0'
+class SceneCache
+{
+    public:
+        static std::string cachePath(const std::string& objPath){ return objPath + ".cache"; }
+
+        // Retorna false se nao ha cache valido para source
+        static bool load(const std::string& objPath, const MappedFile& source, std::vector<Object*>& objs);
+        static void save(const std::string& objPath, const MappedFile& source, std::vector<Object*>& objs);
+
+    private:
+        struct Header
+        {
+            char magic[8];
+            std::uint32_t version;
+            std::uint32_t numObjects;
+            std::uint64_t sourceSize;
+            std::int64_t sourceMtime;
+            std::uint64_t sourceHash;
+            std::uint64_t numVertices;
+            std::uint64_t numIndices;
+            std::uint64_t numFaces;
+            std::uint64_t namesSize;
+        };
+
+        struct Entry
+        {
+            std::uint32_t type;// obj_type
+            std::uint32_t filled;
+            std::uint64_t nameOffset, nameSize;
+            std::uint64_t firstVertex, numVertices;
+            std::uint64_t firstIndex, numIndices;// Somente objetos 3D
+            std::uint64_t firstFace, numFaces;
+        };
+
+        static Object* loadObject(const Entry& entry, const Header& header, const double* vertices,
+                                  const std::int32_t* indices, const std::int32_t* faceSizes,
+                                  const std::uint8_t* faceFilled, const char* names);
+        static std::uint64_t hash(const char* data, std::size_t size);
+
+        static constexpr char MAGIC[8] = "CGSCENE";
+        static const std::uint32_t VERSION = 1;
+};
+
 class ObjStream
 {
     public:
@@ -81,27 +179,68 @@ class ObjReader : public ObjStream
         std::vector<Object*>& getObjs(){ return m_objs; }
 
     private:
+        // Diretiva que cria ou muda objetos. Sao guardadas na
+        //  ordem do arquivo durante a leitura paralela e
+        //  aplicadas depois, uma a uma
+        struct Statement
+        {
+            char keyWord;// 'o', 'p', 'l', 'f', 'c' (curv) ou 't' (cstype)
+            int first, count;// Indices dos vertices em Chunk::indexes
+            std::string_view line;// Resto da linha, para 'o' e 'cstype'
+            const char* error;// Erro encontrado lendo a linha, se houver
+        };
+
+        // Pedaco do arquivo lido por uma thread. Comeca e
+        //  termina em quebras de linha, e nunca separa uma
+        //  linha continuada com '\' da seguinte
+        struct Chunk
+        {
+            const char* begin;
+            const char* end;
+            int firstCoord = 0;// Coordenadas 'v' antes deste pedaco
+            int numCoords = 0;
+            std::vector<int> indexes;
+            std::vector<Statement> statements;
+        };
+
         void loadObjs();
-        void setName(std::stringstream& line);
+        std::vector<Chunk> splitChunks(std::size_t numChunks) const;
+        void countCoords(Chunk& chunk) const;
+        void parseChunk(Chunk& chunk);
+        void runStatement(const Chunk& chunk, const Statement& statement);
+
+        void setName(std::string_view& line);
         // void loadColorsFile(std::stringstream& line);
         // void changeColor(std::stringstream& line);
 
-        void addCoord(std::stringstream& line);
-        void addPoint(std::stringstream& line);
-        void addPoly(std::stringstream& line, bool filled = false);
-        void addFace(std::stringstream& line);
-        void addCurve(std::stringstream& line);
+        void addPoint(const int* indexes, int count);
+        void addPoly(const int* indexes, int count, bool filled = false);
+        void addFace(const int* indexes, int count);
+        void addCurve(const int* indexes, int count);
 
         void addObj3D();
 
-        void loadCoordsIndexes(std::stringstream& line, Coordinates& objCoords);
+        const char* loadCoordsIndexes(std::string_view& line, const char*& cursor, const char* end,
+                                      int numCoords, std::vector<int>& indexes) const;
 
         // Usado para destruir os objs caso de algum erro
         void destroyObjs();
 
-        void setFreeFormType(std::stringstream& line);
+        void setFreeFormType(std::string_view& line);
+
+        // Tokenizer: as linhas e palavras apontam direto
+        //  para o arquivo mapeado, nada eh copiado
+        static bool nextLine(const char*& cursor, const char* end, std::string_view& line);
+        static std::string_view nextToken(std::string_view& line);
+        static double parseDouble(std::string_view token);
+        static bool usesIndexes(std::string_view keyWord);
 
     private:
+        // Pedacos menores que isso nao compensam uma thread
+        static const std::size_t MIN_CHUNK_SIZE = 1 << 20;
+
+        MappedFile m_file;
+
         std::vector<Object*> m_objs;
         Coordinates m_coords;// Todas as coordenadas lidas do arquivo
         // ColorReader m_cReader;
@@ -111,7 +250,13 @@ class ObjReader : public ObjStream
         obj_type m_freeFormType = obj_type::OBJECT;
 
         std::string m_faceName = "";
-        face_list m_faces;
+        // Faces do objeto 3D atual, com os vertices compartilhados
+        IndexedMesh m_mesh;
+        // Index em m_coords -> index em m_mesh, -1 se ainda nao esta nele
+        std::vector<int> m_meshIndexes;
+        // Indexes em m_coords ja usados por m_mesh
+        std::vector<int> m_meshCoords;
+        std::vector<int> m_faceIndexes;
 };
 
 class ObjWriter : public ObjStream
@@ -139,14 +284,273 @@ ObjStream::ObjStream(std::string& filename) {
     m_name = filename.substr(found+1, filename.size()-found-5);// Nome sem o '.obj'
 }
 
+MappedFile::MappedFile(const std::string& filename){
+    m_fd = open(filename.c_str(), O_RDONLY);
+    if(m_fd < 0)
+        return;
+
+    struct stat info;
+    if(fstat(m_fd, &info) != 0){
+        close(m_fd);
+        m_fd = -1;
+        return;
+    }
+
+    m_mtime = (std::int64_t) info.st_mtim.tv_sec*1000000000 + info.st_mtim.tv_nsec;
+
+    // mmap nao aceita tamanho 0, arquivo vazio fica sem dados
+    m_size = info.st_size;
+    if(m_size == 0)
+        return;
+
+    void* data = mmap(nullptr, m_size, PROT_READ, MAP_PRIVATE, m_fd, 0);
+    if(data == MAP_FAILED){
+        close(m_fd);
+        m_fd = -1;
+        m_size = 0;
+        return;
+    }
+    madvise(data, m_size, MADV_SEQUENTIAL);
+    m_data = (const char*) data;
+}
+
+MappedFile::~MappedFile(){
+    if(m_data != nullptr)
+        munmap((void*) m_data, m_size);
+    if(m_fd >= 0)
+        close(m_fd);
+}
+
+// FNV-1a, 8 bytes por vez
+std::uint64_t SceneCache::hash(const char* data, std::size_t size){
+    std::uint64_t h = 14695981039346656037ull;
+    std::size_t i = 0;
+    for(; i + 8 <= size; i += 8){
+        std::uint64_t word;
+        std::memcpy(&word, data + i, 8);
+        h = (h ^ word) * 1099511628211ull;
+    }
+    for(; i < size; i++)
+        h = (h ^ (unsigned char) data[i]) * 1099511628211ull;
+    return h;
+}
+
+bool SceneCache::load(const std::string& objPath, const MappedFile& source, std::vector<Object*>& objs){
+    MappedFile cache(cachePath(objPath));
+    if(!cache.is_open() || cache.size() < sizeof(Header))
+        return false;
+
+    Header header;
+    std::memcpy(&header, cache.data(), sizeof(Header));
+    if(std::memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0 || header.version != VERSION)
+        return false;
+
+    // O .obj mudou depois que o cache foi salvo
+    if(header.sourceSize != source.size() || header.sourceMtime != source.mtime() ||
+       header.sourceHash != hash(source.data(), source.size()))
+        return false;
+
+    // Contadores maiores que o arquivo so podem ser lixo,
+    //  e assim as contas abaixo nao estouram
+    std::uint64_t size = cache.size();
+    if(header.numObjects > size || header.numVertices > size || header.numIndices > size ||
+       header.numFaces > size || header.namesSize > size)
+        return false;
+    if(size != sizeof(Header) + header.numObjects*sizeof(Entry) + 3*header.numVertices*sizeof(double) +
+               (header.numIndices + header.numFaces)*sizeof(std::int32_t) + header.numFaces + header.namesSize)
+        return false;
+
+    const Entry* entries = (const Entry*) (cache.data() + sizeof(Header));
+    const double* vertices = (const double*) (entries + header.numObjects);
+    const std::int32_t* indices = (const std::int32_t*) (vertices + 3*header.numVertices);
+    const std::int32_t* faceSizes = indices + header.numIndices;
+    const std::uint8_t* faceFilled = (const std::uint8_t*) (faceSizes + header.numFaces);
+    const char* names = (const char*) (faceFilled + header.numFaces);
+
+    std::vector<Object*> loaded;
+    loaded.reserve(header.numObjects);
+    for(std::uint32_t i = 0; i < header.numObjects; i++){
+        Object* obj = nullptr;
+        try{
+            obj = loadObject(entries[i], header, vertices, indices, faceSizes, faceFilled, names);
+        }catch(...){}
+
+        // Cache corrompido, le o .obj de novo
+        if(obj == nullptr){
+            for(auto o : loaded)
+                delete o;
+            return false;
+        }
+        loaded.push_back(obj);
+    }
+
+    objs.insert(objs.end(), loaded.begin(), loaded.end());
+    return true;
+}
+
+Object* SceneCache::loadObject(const Entry& entry, const Header& header, const double* vertices,
+                               const std::int32_t* indices, const std::int32_t* faceSizes,
+                               const std::uint8_t* faceFilled, const char* names){
+    if(entry.nameOffset > header.namesSize || entry.nameSize > header.namesSize - entry.nameOffset ||
+       entry.firstVertex > header.numVertices || entry.numVertices > header.numVertices - entry.firstVertex ||
+       entry.firstIndex > header.numIndices || entry.numIndices > header.numIndices - entry.firstIndex ||
+       entry.firstFace > header.numFaces || entry.numFaces > header.numFaces - entry.firstFace)
+        return nullptr;
+
+    std::string name(names + entry.nameOffset, entry.nameSize);
+    const double* v = vertices + 3*entry.firstVertex;
+
+    if(entry.type == obj_type::OBJECT_3D){
+        IndexedMesh mesh;
+        mesh.reserve(entry.numVertices, entry.numIndices, entry.numFaces);
+        for(std::uint64_t i = 0; i < entry.numVertices; i++)
+            mesh.add_vertex(Coordinate(v[3*i], v[3*i+1], v[3*i+2]));
+
+        const std::int32_t* face = indices + entry.firstIndex;
+        const std::int32_t* facesEnd = face + entry.numIndices;
+        for(std::uint64_t f = entry.firstFace; f < entry.firstFace + entry.numFaces; f++){
+            std::int32_t count = faceSizes[f];
+            if(count < 0 || count > facesEnd - face)
+                return nullptr;
+            for(std::int32_t i = 0; i < count; i++)
+                if(face[i] < 0 || (std::uint64_t) face[i] >= entry.numVertices)
+                    return nullptr;
+            mesh.add_face(face, count, faceFilled[f]);
+            face += count;
+        }
+        if(face != facesEnd)
+            return nullptr;
+        return new Object3D(name, std::move(mesh));
+    }
+
+    Coordinates coords;
+    coords.reserve(entry.numVertices);
+    for(std::uint64_t i = 0; i < entry.numVertices; i++)
+        coords.emplace_back(v[3*i], v[3*i+1], v[3*i+2]);
+
+    switch(entry.type){
+    case obj_type::POINT:
+        return coords.size() == 1 ? new Point(name, coords[0]) : nullptr;
+    case obj_type::LINE:
+        return new Line(name, coords);
+    case obj_type::POLYGON:
+        return new Polygon(name, coords, entry.filled);
+    case obj_type::BEZIER_CURVE:
+        return new BezierCurve(name, coords);
+    case obj_type::BSPLINE_CURVE:
+        return new BsplineCurve(name, coords);
+    default:
+        return nullptr;
+    }
+}
+
+void SceneCache::save(const std::string& objPath, const MappedFile& source, std::vector<Object*>& objs){
+    Header header{};
+    std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+    header.version = VERSION;
+    header.numObjects = objs.size();
+    header.sourceSize = source.size();
+    header.sourceMtime = source.mtime();
+    header.sourceHash = hash(source.data(), source.size());
+
+    std::vector<Entry> entries;
+    std::vector<double> vertices;
+    std::vector<std::int32_t> indices, faceSizes;
+    std::vector<std::uint8_t> faceFilled;
+    std::string names;
+
+    auto addVertices = [&](const Coordinates& coords){
+        for(const auto &c : coords){
+            vertices.push_back(c[0]);
+            vertices.push_back(c[1]);
+            vertices.push_back(c[2]);
+        }
+        return coords.size();
+    };
+
+    for(auto obj : objs){
+        Entry entry{};
+        entry.type = obj->get_type();
+        entry.nameOffset = names.size();
+        entry.nameSize = obj->get_name().size();
+        names += obj->get_name();
+        entry.firstVertex = vertices.size()/3;
+        entry.firstIndex = indices.size();
+        entry.firstFace = faceSizes.size();
+
+        switch(obj->get_type()){
+        case obj_type::POINT:
+        case obj_type::LINE:
+            entry.numVertices = addVertices(obj->get_coords());
+            break;
+        case obj_type::POLYGON:
+            entry.numVertices = addVertices(obj->get_coords());
+            entry.filled = obj->isFilled();
+            break;
+        case obj_type::BEZIER_CURVE:
+        case obj_type::BSPLINE_CURVE:
+            entry.numVertices = addVertices(((Curve*) obj)->get_control_points());
+            break;
+        case obj_type::OBJECT_3D:{
+            const auto &mesh = ((Object3D*) obj)->get_mesh();
+            entry.numVertices = addVertices(mesh.get_vertices());
+            for(int f = 0; f < mesh.face_count(); f++){
+                indices.insert(indices.end(), mesh.face(f), mesh.face(f) + mesh.face_size(f));
+                faceSizes.push_back(mesh.face_size(f));
+                faceFilled.push_back(mesh.is_face_filled(f));
+            }
+            entry.numIndices = indices.size() - entry.firstIndex;
+            entry.numFaces = faceSizes.size() - entry.firstFace;
+            break;
+        }
+        default:
+            return;// Tipo que o ObjReader nao cria, nao salva o cache
+        }
+        entries.push_back(entry);
+    }
+
+    header.numVertices = vertices.size()/3;
+    header.numIndices = indices.size();
+    header.numFaces = faceSizes.size();
+    header.namesSize = names.size();
+
+    // Escreve em um arquivo temporario e troca no fim, para
+    //  nunca deixar um cache pela metade no lugar do antigo
+    std::string path = cachePath(objPath);
+    std::string tmpPath = path + ".tmp";
+    {
+        std::ofstream out(tmpPath, std::ios::binary | std::ios::trunc);
+        if(!out.is_open())
+            return;// Sem permissao na pasta, fica sem cache
+
+        out.write((const char*) &header, sizeof(header));
+        out.write((const char*) entries.data(), entries.size()*sizeof(Entry));
+        out.write((const char*) vertices.data(), vertices.size()*sizeof(double));
+        out.write((const char*) indices.data(), indices.size()*sizeof(std::int32_t));
+        out.write((const char*) faceSizes.data(), faceSizes.size()*sizeof(std::int32_t));
+        out.write((const char*) faceFilled.data(), faceFilled.size());
+        out.write(names.data(), names.size());
+        if(!out){
+            out.close();
+            std::remove(tmpPath.c_str());
+            return;
+        }
+    }
+    if(std::rename(tmpPath.c_str(), path.c_str()) != 0)
+        std::remove(tmpPath.c_str());
+}
+
 ObjReader::ObjReader(std::string& filename):
-    ObjStream(filename){
+    ObjStream(filename),
+    m_file(filename){
 
-    m_objsFile.open(filename.c_str());
-    if(!m_objsFile.is_open())
+    if(!m_file.is_open())
         throw "Erro tentando abrir o arquivo";
-    else
+
+    if(!SceneCache::load(filename, m_file, m_objs)){
         loadObjs();
+        SceneCache::save(filename, m_file, m_objs);
+    }
 }
 
 void ObjReader::destroyObjs(){
@@ -158,56 +562,216 @@ void ObjReader::addObj3D(){
     std::string name = m_numSubObjs == 0 ? m_name :
         m_name+"_sub"+std::to_string(m_numSubObjs);
 
-    m_objs.push_back(new Object3D(name, m_faces));
-    m_faces.clear();
+    m_objs.push_back(new Object3D(name, m_mesh));
+    m_mesh.clear();
+    for(auto index : m_meshCoords)
+        m_meshIndexes[index] = -1;
+    m_meshCoords.clear();
+}
+
+bool ObjReader::nextLine(const char*& cursor, const char* end, std::string_view& line){
+    if(cursor >= end)
+        return false;
+
+    const char* lineEnd = (const char*) std::memchr(cursor, '\n', end - cursor);
+    if(lineEnd == nullptr)
+        lineEnd = end;
+
+    line = std::string_view(cursor, lineEnd - cursor);
+    cursor = lineEnd < end ? lineEnd + 1 : lineEnd;
+
+    // Arquivos salvos no windows terminam as linhas com "\r\n"
+    if(!line.empty() && line.back() == '\r')
+        line.remove_suffix(1);
+    return true;
+}
+
+std::string_view ObjReader::nextToken(std::string_view& line){
+    std::size_t begin = 0;
+    while(begin < line.size() && (line[begin] == ' ' || line[begin] == '\t'))
+        begin++;
+
+    std::size_t end = begin;
+    while(end < line.size() && line[end] != ' ' && line[end] != '\t')
+        end++;
+
+    std::string_view token = line.substr(begin, end - begin);
+    line.remove_prefix(end);
+    return token;
+}
+
+double ObjReader::parseDouble(std::string_view token){
+    if(!token.empty() && token[0] == '+')
+        token.remove_prefix(1);
+
+    double value = 0;
+    std::from_chars(token.data(), token.data() + token.size(), value);
+    return value;
+}
+
+// Diretivas com lista de vertices, que podem continuar na linha seguinte
+bool ObjReader::usesIndexes(std::string_view keyWord){
+    return keyWord == "p" || keyWord == "l" || keyWord == "f" || keyWord == "curv";
 }
 
 void ObjReader::loadObjs(){
-    std::string tmp, keyWord;
-    while(std::getline(m_objsFile, tmp)){
-        if(tmp.size() <= 1) continue;
-        std::stringstream line(tmp);
-        line >> keyWord;
-
-        if(keyWord == "#")              { /* Não faz nada... */ }
-        else if(keyWord == "mtllib")    { /* Não faz nada... */ }                    // mtllib filename
-        else if(keyWord == "usemtl")    { /* Não faz nada... */ }                    // usemtl material_name
-        else if(keyWord == "v")         { addCoord(line); }                          // v x y z
-        else if(keyWord == "o")         { setName(line); }                           // o obj_name
-        else if(keyWord == "w")         { /* TODO(?) */ }
-        else if(keyWord == "p")         { addPoint(line); }                          // p v1 v2 v3 ...
-        else if(keyWord == "l")         { addPoly(line, false); }                    // l v1 v2 v3 ...
-        else if(keyWord == "f")         { addFace(line); }                           // f v1/vt1/vn1 v2/vt2/vn2 ...
-        else if(keyWord == "curv")      { addCurve(line); }                          // curv u1 u2 v1 v2 v3 ...
-        else if(keyWord == "cstype")    { setFreeFormType(line); }                   // cstype type
-
-        else if(keyWord == "end")       { /* Não intendi o que os 'param' significam,
-                                              então só estou lendo o 'end' e não estou
-                                              fazendo nada...*/ }
-        else if(keyWord == "deg")       { /* Não faz nada... */ }                    // deg degu
-        else if(keyWord == "g")         { /* Não faz nada... */ }                    // g group_name
-        else if(keyWord == "vt")        { /* Não faz nada... */ }                    // vt u v w
-        else if(keyWord == "vn")        { /* Não faz nada... */ }                    // vn i j k
-        else if(keyWord == "vp")        { /* Não faz nada... */ }                    // vp u v w
-    }	 	  	 	     	  		  	  	    	      	 	
+    //  A leitura eh feita em duas fases. Primeiro cada pedaco
+    //  do arquivo conta suas coordenadas 'v', e a soma dos
+    //  pedacos anteriores diz o index global da primeira
+    //  coordenada de cada um. Com isso os pedacos podem ser
+    //  lidos ao mesmo tempo, ja resolvendo os indices negativos
+    std::size_t threads = std::max(1u, std::thread::hardware_concurrency());
+    std::size_t numChunks = std::min(m_file.size() / MIN_CHUNK_SIZE + 1, 4*threads);
+    std::vector<Chunk> chunks = splitChunks(numChunks);
+
+    WorkerPool pool(chunks.size() > 1 ? 0 : 1);
+    pool.parallel_for(chunks.size(), 1, [&](std::size_t i){ countCoords(chunks[i]); });
+
+    int numCoords = 0;
+    for(auto &chunk : chunks){
+        chunk.firstCoord = numCoords;
+        numCoords += chunk.numCoords;
+    }
+    m_coords.resize(numCoords);
+    m_meshIndexes.assign(numCoords, -1);
+
+    pool.parallel_for(chunks.size(), 1, [&](std::size_t i){ parseChunk(chunks[i]); });
+
+    // Objetos sao criados na ordem do arquivo
+    for(const auto &chunk : chunks)
+        for(const auto &statement : chunk.statements)
+            runStatement(chunk, statement);
+
     // Se chegar ao final e tiver alguma
     //  Face salva, ela pertence ao ultimo
     //  objeto 3D
-    if(m_faces.size() != 0)
+    if(m_mesh.face_count() != 0)
         addObj3D();
 }
 
-void ObjReader::setName(std::stringstream& line){
+std::vector<ObjReader::Chunk> ObjReader::splitChunks(std::size_t numChunks) const{
+    const char* fileBegin = m_file.data();
+    const char* fileEnd = fileBegin + m_file.size();
+
+    std::vector<Chunk> chunks;
+    const char* begin = fileBegin;
+    for(std::size_t i = 1; i <= numChunks && begin < fileEnd; i++){
+        const char* end = fileBegin + m_file.size()*i/numChunks;
+        if(end < begin)
+            end = begin;
+
+        // Corta logo depois de uma quebra de linha, pulando
+        //  as linhas que continuam na seguinte
+        while(end < fileEnd){
+            const char* newLine = (const char*) std::memchr(end, '\n', fileEnd - end);
+            end = newLine == nullptr ? fileEnd : newLine + 1;
+            if(end == fileEnd)
+                break;
+
+            const char* lineBegin = newLine;
+            while(lineBegin > fileBegin && lineBegin[-1] != '\n')
+                lineBegin--;
+            if(std::memchr(lineBegin, '\\', newLine - lineBegin) == nullptr)
+                break;
+        }
+
+        chunks.emplace_back();
+        chunks.back().begin = begin;
+        chunks.back().end = end;
+        begin = end;
+    }
+    return chunks;
+}
+
+void ObjReader::countCoords(Chunk& chunk) const{
+    const char* cursor = chunk.begin;
+    std::string_view line;
+    while(nextLine(cursor, chunk.end, line)){
+        std::string_view keyWord = nextToken(line);
+        if(keyWord == "v")
+            chunk.numCoords++;
+        else if(usesIndexes(keyWord)){
+            // Linhas de continuacao nao sao diretivas
+            while(line.find('\\') != std::string_view::npos && nextLine(cursor, chunk.end, line));
+        }
+    }
+}
+
+void ObjReader::parseChunk(Chunk& chunk){
+    const char* cursor = chunk.begin;
+    int numCoords = chunk.firstCoord;
+    std::string_view line;
+    while(nextLine(cursor, chunk.end, line)){
+        std::string_view keyWord = nextToken(line);
+        if(keyWord.empty()) continue;// Linha em branco
+
+        if(keyWord == "v"){                                                         // v x y z
+            double x = parseDouble(nextToken(line));
+            double y = parseDouble(nextToken(line));
+            double z = parseDouble(nextToken(line));
+            m_coords[numCoords++] = Coordinate(x,y,z);
+        }
+        else if(keyWord == "o")         { chunk.statements.push_back({'o', 0, 0, line, nullptr}); }  // o obj_name
+        else if(keyWord == "cstype")    { chunk.statements.push_back({'t', 0, 0, line, nullptr}); }  // cstype type
+        else if(usesIndexes(keyWord)){
+            // p v1 v2 v3 ...
+            // l v1 v2 v3 ...
+            // f v1/vt1/vn1 v2/vt2/vn2 ...
+            // curv u1 u2 v1 v2 v3 ...
+            Statement statement{keyWord == "curv" ? 'c' : keyWord[0], (int) chunk.indexes.size(), 0, {}, nullptr};
+            if(keyWord == "curv"){
+                nextToken(line);// Remove o u1 e u2 que não sei para que servem...
+                nextToken(line);
+            }
+
+            statement.error = loadCoordsIndexes(line, cursor, chunk.end, numCoords, chunk.indexes);
+            statement.count = chunk.indexes.size() - statement.first;
+            chunk.statements.push_back(statement);
+
+            // O resto do pedaco nao sera usado
+            if(statement.error != nullptr)
+                return;
+        }
+        // As outras diretivas (#, mtllib, usemtl, w, end,
+        //  deg, g, vt, vn, vp) sao ignoradas
+    }
+}
+
+void ObjReader::runStatement(const Chunk& chunk, const Statement& statement){
+    if(statement.keyWord == 'c' && m_freeFormType == obj_type::OBJECT){
+        destroyObjs();
+        throw "Tentativa de criar uma curva sem 'cstype' na linha";
+    }
+    if(statement.error != nullptr){
+        destroyObjs();
+        throw statement.error;
+    }
+
+    std::string_view line = statement.line;
+    const int* indexes = chunk.indexes.data() + statement.first;
+    switch(statement.keyWord){
+    case 'o': setName(line); break;
+    case 't': setFreeFormType(line); break;
+    case 'p': addPoint(indexes, statement.count); break;
+    case 'l': addPoly(indexes, statement.count, false); break;
+    case 'f': addFace(indexes, statement.count); break;
+    case 'c': addCurve(indexes, statement.count); break;
+    }
+}
+
+void ObjReader::setName(std::string_view& line){
     //  Caso o nome do objeto mude, deve-se checar
     //  se ja foi carregado alguma Face. Caso tenha sido,
     //  deve-se então criar o objeto 3D com as Faces
     //  carregadas até agora
-    if(m_faces.size() != 0)
+    if(m_mesh.face_count() != 0)
         addObj3D();
 
-    line >> m_name;
+    std::string_view name = nextToken(line);
+    if(!name.empty())
+        m_name = std::string(name);
     m_numSubObjs = 0;
-}
+}	 	  	 	     	  		  	  	    	      	 	
 
 // void ObjReader::loadColorsFile(std::stringstream& line){
 //     std::string file;
@@ -221,37 +785,29 @@ void ObjReader::setName(std::stringstream& line){
 //     m_color = m_cReader.getColor(colorName);
 // }
 
-void ObjReader::addCoord(std::stringstream& line){
-    double x=0,y=0,z=0;
-    line >> x >> y >> z;
-    m_coords.emplace_back(x,y,z);
-}	 	  	 	     	  		  	  	    	      	 	
-
-void ObjReader::addPoint(std::stringstream& line){
-    if(m_faces.size() != 0)
+void ObjReader::addPoint(const int* indexes, int count){
+    if(m_mesh.face_count() != 0)
         addObj3D();
 
-    Coordinates objCoords;
-    loadCoordsIndexes(line, objCoords);
-
     std::string name = m_numSubObjs == 0 ? m_name :
         m_name+"_sub"+std::to_string(m_numSubObjs);
 
     // Pode-se declarar varios pontos
     //  em uma mesma linha 'p'
-    for(auto &c : objCoords){
-        m_objs.push_back(new Point(name, c));
+    for(int i = 0; i < count; i++){
+        m_objs.push_back(new Point(name, m_coords[indexes[i]]));
         m_numSubObjs++;
         name = m_name+"_sub"+std::to_string(m_numSubObjs);
     }
 }
 
-void ObjReader::addPoly(std::stringstream& line, bool filled){
-    if(m_faces.size() != 0)
+void ObjReader::addPoly(const int* indexes, int count, bool filled){
+    if(m_mesh.face_count() != 0)
         addObj3D();
 
     Coordinates objCoords;
-    loadCoordsIndexes(line, objCoords);
+    for(int i = 0; i < count; i++)
+        objCoords.push_back(m_coords[indexes[i]]);
 
     std::string name = m_numSubObjs == 0 ? m_name :
         m_name+"_sub"+std::to_string(m_numSubObjs);
@@ -263,29 +819,42 @@ void ObjReader::addPoly(std::stringstream& line, bool filled){
     m_numSubObjs++;
 }	 	  	 	     	  		  	  	    	      	 	
 
-void ObjReader::addFace(std::stringstream& line){
-    Coordinates objCoords;
-    loadCoordsIndexes(line, objCoords);
-
-    std::string name = "face"+std::to_string(m_faces.size()+1);
-    m_faces.emplace_back(name, objCoords, false);
-}
+void ObjReader::addFace(const int* indexes, int count){
+    // Uma face com 2 vertices e so uma aresta: vira uma Line,
+    //  como no addPoly. Com menos nao ha o que desenhar
+    if(count < 3){
+        if(count == 2){
+            std::string name = m_numSubObjs == 0 ? m_name :
+                m_name+"_sub"+std::to_string(m_numSubObjs);
+            Coordinates objCoords = {m_coords[indexes[0]], m_coords[indexes[1]]};
+            m_objs.push_back(new Line(name, objCoords));
+            m_numSubObjs++;
+        }
+        return;
+    }
 
-void ObjReader::addCurve(std::stringstream& line){
-    if(m_freeFormType == obj_type::OBJECT){
-        destroyObjs();
-        throw "Tentativa de criar uma curva sem 'cstype' na linha";
+    // Cada vertice entra uma unica vez no objeto 3D,
+    //  as faces guardam so o index dele
+    // Reaproveitado entre as faces, para nao alocar a cada linha 'f'
+    m_faceIndexes.clear();
+    for(int i = 0; i < count; i++){
+        int &index = m_meshIndexes[indexes[i]];
+        if(index < 0){
+            index = m_mesh.add_vertex(m_coords[indexes[i]]);
+            m_meshCoords.push_back(indexes[i]);
+        }
+        m_faceIndexes.push_back(index);
     }
+    m_mesh.add_face(m_faceIndexes);
+}
 
-    if(m_faces.size() != 0)
+void ObjReader::addCurve(const int* indexes, int count){
+    if(m_mesh.face_count() != 0)
         addObj3D();
 
-    double tmp=0;
-    line >> tmp;// Remove o u1 e u2 que não sei para que servem...
-    line >> tmp;
-
     Coordinates objCoords;
-    loadCoordsIndexes(line, objCoords);
+    for(int i = 0; i < count; i++)
+        objCoords.push_back(m_coords[indexes[i]]);
 
     std::string name = m_numSubObjs == 0 ? m_name :
         m_name+"_sub"+std::to_string(m_numSubObjs);
@@ -297,60 +866,50 @@ void ObjReader::addCurve(std::stringstream& line){
     m_numSubObjs++;
 }
 
-void ObjReader::loadCoordsIndexes(std::stringstream& line, Coordinates& objCoords){	 	  	 	     	  		  	  	    	      	 	
-    std::string pointString;
-    int index = 0;
-    int size = m_coords.size();
-
+// Retorna o erro encontrado, ou nullptr. Indices negativos
+//  sao relativos as numCoords coordenadas lidas ate a linha
+const char* ObjReader::loadCoordsIndexes(std::string_view& line, const char*& cursor, const char* end,
+                                         int numCoords, std::vector<int>& indexes) const{
     while(true){
-        while(line >> pointString){
+        // Linha inteira, para procurar o '\' depois
+        std::string_view fullLine = line;
+
+        for(std::string_view point = nextToken(line); !point.empty(); point = nextToken(line)){
             // Algoritmo vai pegar o vertice 'v' e vai
             //  ignorar os outros [v/vt/vn]
-            std::stringstream point(pointString);
-
-            if(point.str() == "\\")
+            if(point == "\\")
                 continue;
 
-            point >> index;
+            if(point[0] == '+')
+                point.remove_prefix(1);
 
-            if(!point){// É obrigado a ter um vertice
-                destroyObjs();
-                throw "Indice de vertice invalido na linha";
-            }
+            int index = 0;
+            auto result = std::from_chars(point.data(), point.data() + point.size(), index);
+
+            if(result.ec != std::errc())// É obrigado a ter um vertice
+                return "Indice de vertice invalido na linha";
 
             // Processa o index do vertice
             if(index < 0)
-                index = size + index;
+                index = numCoords + index;
             else
                 index--;
 
-            if(index < 0 || index >= size){
-                destroyObjs();
-                throw "Indice de vertice invalido na linha";
-            }
-            objCoords.push_back(m_coords[index]);
-        }
-        if(line.str().find("\\") == std::string::npos)
-            break;
-        else{
-            // Pegue a proxima linha caso ache '\'
-            //  ao final da linha atual
-            std::string tmp;
-            if(std::getline(m_objsFile, tmp)){	 	  	 	     	  		  	  	    	      	 	
-                //line = std::stringstream(tmp);
-                line.str(tmp);
-                line.clear();
-            }else
-                break;
+            if(index < 0 || index >= numCoords)
+                return "Indice de vertice invalido na linha";
+            indexes.push_back(index);
         }
+        // Pegue a proxima linha caso ache '\'
+        //  ao final da linha atual
+        if(fullLine.find('\\') == std::string_view::npos || !nextLine(cursor, end, line))
+            return nullptr;
     }
 }
 
-void ObjReader::setFreeFormType(std::stringstream& line){
-    std::string type;
-    line >> type;
+void ObjReader::setFreeFormType(std::string_view& line){
+    std::string_view type = nextToken(line);
 
-    if(type == "rat"){ line >> type; }// Nao intendi bem o que isto quer dizer...
+    if(type == "rat"){ type = nextToken(line); }// Nao intendi bem o que isto quer dizer...
 
     if(type == "bezier"){ m_freeFormType = obj_type::BEZIER_CURVE; }
     else if(type == "bspline"){ m_freeFormType = obj_type::BSPLINE_CURVE; }
@@ -373,10 +932,7 @@ void ObjWriter::writeObjs(Viewport* viewport){
     // m_cWriter.loadFile(m_path+m_name+".mtl");
     // m_objsFile << "mtllib " << m_name << ".mtl\n\n";
 
-    Object *obj;
-    int size = viewport->get_display_file_size();
-    for(int i = 0; i<size; i++){	 	  	 	     	  		  	  	    	      	 	
-        obj = viewport->getObject(i);
+    for(auto obj : viewport->get_display_file()){	 	  	 	     	  		  	  	    	      	 	
         if(obj->get_type() == obj_type::OBJECT_3D)
             printObj3D((Object3D*) obj);
         else
@@ -442,26 +998,22 @@ void ObjWriter::printObj(Object* obj){
 }
 
 void ObjWriter::printObj3D(Object3D* obj){
+    const auto &mesh = obj->get_mesh();
 
-    for(auto face : obj->get_face_list()){
-        auto coords = face.get_coords();
-        for(const auto &c : coords)
-            m_objsFile << "v " << c[0] << " " << c[1] << " " << c[2] << "\n";
-    }
+    for(const auto &c : mesh.get_vertices())
+        m_objsFile << "v " << c[0] << " " << c[1] << " " << c[2] << "\n";
     m_objsFile << "\no " << obj->get_name() << "\n";
 
-    unsigned int face_size = 0;
-    for(auto face : obj->get_face_list()){
-        face_size = face.get_coords().size();
+    for(int f = 0; f < mesh.face_count(); f++){
+        const int* face = mesh.face(f);
 
-        //m_objsFile << "g " << face.get_name() << "\n";
         m_objsFile << "f";
-        for(unsigned int i = 0; i<face_size; i++){
-            m_objsFile << " " << m_numVertex+(i+1);
+        for(int i = 0; i<mesh.face_size(f); i++){
+            m_objsFile << " " << m_numVertex+face[i]+1;
         }
         m_objsFile << "\n";
-        m_numVertex += face_size;
     }
+    m_numVertex += mesh.get_vertices().size();
 }	 	  	 	     	  		  	  	    	      	 	
 
 // bool ColorReader::loadFile(const std::string& filename){
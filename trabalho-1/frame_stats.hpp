@@ -0,0 +1,149 @@
+#ifndef FRAME_STATS_HPP
+#define FRAME_STATS_HPP
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cairo.h>
+
+/*
+	Per-frame timers and counters for the normalize/clip/draw pipeline.
+
+	Code is instrumented through FRAME_STATS_TIME(stage), which times the
+	rest of the enclosing scope, and FRAME_STATS_COUNT(counter, n). Both
+	expand to nothing unless the build defines FRAME_STATS, so the
+	arguments are not even evaluated in a normal build:
+
+		g++ -DFRAME_STATS ...
+
+	Stages and counters add up from any thread until end_frame(), which
+	moves them to last_frame() for the overlay and the JSON dump. Stage
+	times are inclusive: DRAW contains VIEWPORT, the normalized to
+	viewport coordinate transform done while drawing.
+*/
+class FrameStats {
+	public:
+		enum Stage { WINDOW, NORMALIZE, CLIP, VIEWPORT, DRAW, STAGE_COUNT };
+		enum Counter { OBJECTS, VERTICES, CLIPPED, BACKFACES, SEGMENTS, COUNTER_COUNT };
+
+		struct Frame {
+			unsigned long number = 0;
+			double ms[STAGE_COUNT] = {};
+			std::uint64_t count[COUNTER_COUNT] = {};
+		};
+
+		class ScopedTimer {
+			public:
+				explicit ScopedTimer(Stage stage) :
+					_stage(stage),
+					_start(std::chrono::steady_clock::now())
+				{}
+
+				~ScopedTimer();
+
+			private:
+				Stage _stage;
+				std::chrono::steady_clock::time_point _start;
+		};
+
+		void add_time(Stage stage, std::int64_t ns) {
+			_ns[stage].fetch_add(ns, std::memory_order_relaxed);
+		}
+
+		void add(Counter counter, std::uint64_t n) {
+			_count[counter].fetch_add(n, std::memory_order_relaxed);
+		}
+
+		void end_frame();
+		const Frame& last_frame() const { return _last; }
+
+		void draw_overlay(cairo_t* cr, double x, double y) const;
+		/* One JSON object per call, on a single line */
+		void write_json(std::FILE* out) const;
+
+		static const char* stage_name(int stage);
+		static const char* counter_name(int counter);
+
+	protected:
+	private:
+		std::atomic<std::int64_t> _ns[STAGE_COUNT] = {};
+		std::atomic<std::uint64_t> _count[COUNTER_COUNT] = {};
+		Frame _last;
+		unsigned long _frames = 0;
+};
+
+FrameStats& frame_stats() {
+	static FrameStats stats;
+	return stats;
+}
+
+#ifdef FRAME_STATS
+#define FRAME_STATS_CONCAT_(a, b) a##b
+#define FRAME_STATS_CONCAT(a, b) FRAME_STATS_CONCAT_(a, b)
+#define FRAME_STATS_TIME(stage) \
+	FrameStats::ScopedTimer FRAME_STATS_CONCAT(frame_stats_timer_, __LINE__)(FrameStats::stage)
+#define FRAME_STATS_COUNT(counter, n) frame_stats().add(FrameStats::counter, (n))
+#else
+#define FRAME_STATS_TIME(stage) ((void) 0)
+#define FRAME_STATS_COUNT(counter, n) ((void) 0)
+#endif
+
+FrameStats::ScopedTimer::~ScopedTimer() {
+	auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - _start);
+	frame_stats().add_time(_stage, ns.count());
+}
+
+void FrameStats::end_frame() {
+	_last.number = ++_frames;
+	for (int s = 0; s < STAGE_COUNT; ++s)
+		_last.ms[s] = _ns[s].exchange(0, std::memory_order_relaxed) / 1e6;
+	for (int c = 0; c < COUNTER_COUNT; ++c)
+		_last.count[c] = _count[c].exchange(0, std::memory_order_relaxed);
+}
+
+const char* FrameStats::stage_name(int stage) {
+	static const char* names[STAGE_COUNT] = {"window", "normalize", "clip", "viewport", "draw"};
+	return names[stage];
+}
+
+const char* FrameStats::counter_name(int counter) {
+	static const char* names[COUNTER_COUNT] = {"objects", "vertices", "clipped", "backfaces", "segments"};
+	return names[counter];
+}
+
+void FrameStats::draw_overlay(cairo_t* cr, double x, double y) const {
+	const double line = 12;
+	char text[64];
+
+	cairo_save(cr);
+	cairo_set_source_rgba(cr, 1, 1, 1, 0.8);
+	cairo_rectangle(cr, x - 4, y - line, 150, line * (STAGE_COUNT + COUNTER_COUNT) + 6);
+	cairo_fill(cr);
+
+	cairo_set_source_rgb(cr, 0, 0, 0.6);
+	cairo_set_font_size(cr, 10);
+	for (int s = 0; s < STAGE_COUNT; ++s, y += line) {
+		std::snprintf(text, sizeof(text), "%-10s %8.3f ms", stage_name(s), _last.ms[s]);
+		cairo_move_to(cr, x, y);
+		cairo_show_text(cr, text);
+	}
+	for (int c = 0; c < COUNTER_COUNT; ++c, y += line) {
+		std::snprintf(text, sizeof(text), "%-10s %8llu", counter_name(c), (unsigned long long) _last.count[c]);
+		cairo_move_to(cr, x, y);
+		cairo_show_text(cr, text);
+	}
+	cairo_restore(cr);
+}
+
+void FrameStats::write_json(std::FILE* out) const {
+	std::fprintf(out, "{\"frame\": %lu, \"ms\": {", _last.number);
+	for (int s = 0; s < STAGE_COUNT; ++s)
+		std::fprintf(out, "%s\"%s\": %.6f", s ? ", " : "", stage_name(s), _last.ms[s]);
+	std::fprintf(out, "}, \"count\": {");
+	for (int c = 0; c < COUNTER_COUNT; ++c)
+		std::fprintf(out, "%s\"%s\": %llu", c ? ", " : "", counter_name(c), (unsigned long long) _last.count[c]);
+	std::fprintf(out, "}}\n");
+}
+
+#endif // FRAME_STATS_HPP
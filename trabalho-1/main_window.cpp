@@ -41,8 +41,9 @@ GtkButton* rotate_left;
 GtkButton* rotate_right;
 GtkEntry* step_entry;
 GtkEntry* angle_entry;
-GtkToggleButton *LB_Clipping,*CS_Clipping;
+GtkToggleButton *LB_Clipping,*CS_Clipping,*NLN_Clipping,*AUTO_Clipping;
 GtkToggleButton *check_parallel,*check_perspective;
+GtkToggleButton *check_zbuffer,*check_backface;
 GtkToggleButton *x_check,*y_check,*z_check;
 GtkMenuItem* open_file_m;
 GtkMenuItem* save_file_m;
@@ -56,8 +57,6 @@ enum {
   NUM_COLS
 };
 
-int count_obj = 0;
-
 //Objetos da janela de adicionar forma geometrica
 GObject* add_geometric_shape_w;
 GtkButton* add_point1;
@@ -157,8 +156,8 @@ GtkButton* save_file_b;
 GtkEntry* open_file_entry;
 GtkEntry* save_file_entry;
 
-void fill_treeview(const char* name,const char* type);
-int get_index_selected();
+void fill_treeview(ObjectHandle handle, const char* name, const char* type);
+ObjectHandle get_index_selected();
 
 /* CALLBACKS */
 
@@ -291,8 +290,8 @@ void open_file_event (GtkWidget *widget, gpointer data) {
         ObjReader r(file);
         for(auto obj : r.getObjs()){
             try{
-                viewport->addObject(obj);
-                fill_treeview(obj->get_name().c_str(),obj->get_type_name().c_str());
+                ObjectHandle handle = viewport->addObject(obj);
+                fill_treeview(handle, obj->get_name().c_str(),obj->get_type_name().c_str());
 
                 // gtk_widget_queue_draw(m_mainWindow);
             }catch(char* e){
@@ -332,9 +331,8 @@ void on_add_point_clicked (GtkWidget *widget, gpointer data) {
 	double y1 = atof(gtk_entry_get_text(y1_point_entry));
 	double z1 = atof(gtk_entry_get_text(z1_point_entry));
 
-	fill_treeview(name,"Point");
 	Point* point = new Point(name, x1, y1, z1);
-	viewport->addObject(point);
+	fill_treeview(viewport->addObject(point), name, "Point");
 
     gtk_entry_set_text(name_point_entry,"");
     gtk_entry_set_text(x1_point_entry,"");
@@ -353,9 +351,8 @@ void on_add_line_clicked (GtkWidget *widget, gpointer data) {
 	double y2 = atof(gtk_entry_get_text(y2_line_entry));
 	double z2 = atof(gtk_entry_get_text(z2_line_entry));
 	
-	fill_treeview(name,"Line");
 	Line* line = new Line(name, x1, y1, z1, x2, y2, z2);
-	viewport->addObject(line);
+	fill_treeview(viewport->addObject(line), name, "Line");
     gtk_entry_set_text(name_line_entry,"");
     gtk_entry_set_text(x1_line_entry,"");
     gtk_entry_set_text(x2_line_entry,"");
@@ -381,8 +378,7 @@ void on_add_poly_clicked (GtkWidget *widget, gpointer data) {
   const gchar* name = gtk_entry_get_text(name_poly_entry);
 	Polygon* polygon = new Polygon(name, polygon_coords, gtk_toggle_button_get_active(filled));
 	if (!isObject3D) {
-	    fill_treeview(name,"Polygon");
-	    viewport->addObject(polygon);  
+	    fill_treeview(viewport->addObject(polygon), name, "Polygon");
 	    gtk_widget_hide (GTK_WIDGET(add_poly_w));
 	} else {
 	    faces_object3D.push_back(*polygon);
@@ -413,14 +409,12 @@ void on_add_point_curve_clicked (GtkWidget *widget, gpointer data) {
 void on_add_curve_clicked (GtkWidget *widget, gpointer data) {
   const gchar* name = gtk_entry_get_text(name_curve_entry);
   if (gtk_toggle_button_get_active(bspline_check)){
-        fill_treeview(name,"B-Spline Curve");
         BsplineCurve* curve = new BsplineCurve(name, curve_coords);
-        viewport->addObject(curve);
+        fill_treeview(viewport->addObject(curve), name, "B-Spline Curve");
         curve_coords.clear();
   } else {
-        fill_treeview(name,"Bezier Curve");
         BezierCurve* curve = new BezierCurve(name, curve_coords);
-        viewport->addObject(curve);
+        fill_treeview(viewport->addObject(curve), name, "Bezier Curve");
         curve_coords.clear();
   }
  
@@ -441,9 +435,8 @@ void on_add_face_clicked (GtkWidget *widget, gpointer data) {
 void on_add_object3D_clicked (GtkWidget *widget, gpointer data) {
     const gchar* name = gtk_entry_get_text(name_object3D_entry);
     Object3D* object = new Object3D(name, faces_object3D);
-    fill_treeview(name,"Object3D");
     faces_object3D.clear();
-    viewport->addObject(object);
+    fill_treeview(viewport->addObject(object), name, "Object3D");
     gtk_widget_hide (GTK_WIDGET(add_object3D_w));
 }
 
@@ -488,14 +481,12 @@ void on_add_surface_clicked (GtkWidget *widget, gpointer data) {
   const gchar* name = gtk_entry_get_text(name_surface_entry);
   if(surface_coords.size() == rows_s*columns_s) {
 	  if (gtk_toggle_button_get_active(bspline_checksurface)){
-	        fill_treeview(name,"B-Spline Surface");
 	        BSplineSurface* surface = new BSplineSurface(name, surface_coords);
-	        viewport->addObject(surface);
+	        fill_treeview(viewport->addObject(surface), name, "B-Spline Surface");
 	        surface_coords.clear();
 	  } else if (gtk_toggle_button_get_active(bezier_checksurface)) {
-	        fill_treeview(name,"Bezier Surface");
 	        BezierSurface* surface = new BezierSurface(name, surface_coords);
-	        viewport->addObject(surface);
+	        fill_treeview(viewport->addObject(surface), name, "Bezier Surface");
 	        surface_coords.clear();
 	  } 
 	  
@@ -534,7 +525,7 @@ void on_angle_world_button_clicked (GtkWidget *widget, gpointer data) {
 }
 
 void on_angle_obj_button_clicked(GtkWidget *widget, gpointer data) {
-	int index = get_index_selected();
+	ObjectHandle index = get_index_selected();
 	Coordinate center = (viewport->getObject(index))->get_center_coord();
 	double angle = atof(gtk_entry_get_text(angle_obj_entry));
 	
@@ -577,7 +568,7 @@ void on_schedule_button_clicked (GtkWidget *widget, gpointer data) {
 	double sy = atof(gtk_entry_get_text(sy_entry));
 	double sz = atof(gtk_entry_get_text(sz_entry));
 
-	int index = get_index_selected();
+	ObjectHandle index = get_index_selected();
 	Coordinate center = (viewport->getObject(index))->get_center_coord();
 	accumulator.push_back(Transformation::generate_scaling_around_obj_center_matrix(sx, sy, sz, center));
 }	 	  	 	     	  		  	  	    	      	 	
@@ -621,19 +612,37 @@ gboolean draw_objects(GtkWidget* widget, cairo_t* cr, gpointer data) {
     cairo_line_to(cr, 10, 10);
     cairo_stroke(cr);
 
+#ifdef FRAME_STATS
+	frame_stats().end_frame();
+	frame_stats().draw_overlay(cr, 16, 26);
+#endif
 
-	gtk_widget_queue_draw(draw_viewport);
 	return FALSE;
+}
+
+// Redesenho so quando a cena ou a window mudam: o pedido espera o
+// proximo frame do GTK, e varias mudancas ate la viram um desenho so
+guint redraw_tick = 0;
+
+gboolean redraw_on_tick(GtkWidget* widget, GdkFrameClock* clock, gpointer data) {
+	redraw_tick = 0;
+	gtk_widget_queue_draw(widget);
+	return G_SOURCE_REMOVE;
+}
+
+void request_redraw() {
+	if (redraw_tick == 0)
+		redraw_tick = gtk_widget_add_tick_callback(draw_viewport, redraw_on_tick, NULL, NULL);
 }	 	  	 	     	  		  	  	    	      	 	
 
 void fov_scale_event(){
     //std::cout << gtk_adjustment_get_value (fov_scale)<< std::endl;
     viewport->set_focal_distance(gtk_adjustment_get_value (fov_scale)*PI/180);
 }
-int get_index_selected() {
+ObjectHandle get_index_selected() {
 	GtkTreeIter iter;
 	GtkTreeModel *model;
-	int index;
+	ObjectHandle index;
 
 	if(gtk_tree_selection_get_selected (objects_select, &model, &iter)) {
 		gtk_tree_model_get (model, &iter, COL_ID, &index, -1);
@@ -641,21 +650,29 @@ int get_index_selected() {
 	return index;
 }
 
-void fill_treeview (const char* name, const char* type) {
+void fill_treeview (ObjectHandle handle, const char* name, const char* type) {
 	gtk_list_store_append (store, &iter);
-	gtk_list_store_set (store, &iter, COL_ID, count_obj, COL_NAME, name, COL_TYPE, type,-1);
-	count_obj++;
+	gtk_list_store_set (store, &iter, COL_ID, handle, COL_NAME, name, COL_TYPE, type,-1);
 }
 
-void check() {
-    if (gtk_toggle_button_get_active(CS_Clipping)){
-        gtk_toggle_button_set_active(LB_Clipping, false);
-        viewport->changeLineClipAlg(Line_clip_algs::CS);
-    } else if(gtk_toggle_button_get_active(LB_Clipping)) {
-        gtk_toggle_button_set_active(CS_Clipping, false);
-        viewport->changeLineClipAlg(Line_clip_algs::LB);
-    } else 
+void check(GtkToggleButton* button) {
+    GtkToggleButton* buttons[] = {CS_Clipping, LB_Clipping, NLN_Clipping, AUTO_Clipping};
+    Line_clip_algs algs[] = {Line_clip_algs::CS, Line_clip_algs::LB, Line_clip_algs::NLN, Line_clip_algs::AUTO};
+
+    // only one algorithm checked at a time, Cohen-Sutherland if none
+    if (!gtk_toggle_button_get_active(button)) {
+        for (auto b : buttons)
+            if (gtk_toggle_button_get_active(b))
+                return;
         viewport->changeLineClipAlg(Line_clip_algs::CS);
+        return;
+    }
+    for (int i = 0; i < 4; ++i) {
+        if (buttons[i] == button)
+            viewport->changeLineClipAlg(algs[i]);
+        else
+            gtk_toggle_button_set_active(buttons[i], false);
+    }
 }
 
 void check_parallel_event() {
@@ -671,6 +688,38 @@ void check_perspective_event() {
         viewport->change_view(window_view::PERSPECTIVE);
     }
 }
+void check_zbuffer_event() {
+    // faces preenchidas pelo rasterizador com z-buffer, ou pelo cairo
+    if (gtk_toggle_button_get_active(check_zbuffer))
+        viewport->set_render_backend(Render_backends::RASTER);
+    else
+        viewport->set_render_backend(Render_backends::CAIRO);
+}
+
+Object3D* selected_object3D() {
+    if (!gtk_tree_selection_get_selected(objects_select, NULL, NULL))
+        return nullptr;
+    Object* obj = viewport->getObject(get_index_selected());
+    if (obj == nullptr || obj->get_type() != obj_type::OBJECT_3D)
+        return nullptr;
+    return (Object3D*) obj;
+}
+
+void check_backface_event() {
+    // back-face culling do objeto 3D selecionado
+    Object3D* obj = selected_object3D();
+    bool cull = gtk_toggle_button_get_active(check_backface);
+    if (obj == nullptr || obj->get_backface_culling() == cull)
+        return;
+    obj->set_backface_culling(cull);
+    viewport->normalize_and_clip_obj(obj);
+}
+
+void objects_select_changed() {
+    Object3D* obj = selected_object3D();
+    gtk_toggle_button_set_active(check_backface, obj != nullptr && obj->get_backface_culling());
+}
+
 void check_x() {
     if (gtk_toggle_button_get_active(x_check)) {
         gtk_toggle_button_set_active(y_check, false);
@@ -759,6 +808,7 @@ int main (int argc, char *argv[]) {
 
 	draw_viewport = GTK_WIDGET(gtk_builder_get_object(builder, "draw_viewport"));
 	g_signal_connect(draw_viewport, "draw", G_CALLBACK(draw_objects), NULL);
+	viewport->set_on_change(request_redraw);
 	
 	fov_scale = GTK_ADJUSTMENT(gtk_builder_get_object(builder, "adjustment1"));
     g_signal_connect(fov_scale, "value-changed", G_CALLBACK(fov_scale_event), NULL);
@@ -956,8 +1006,12 @@ int main (int argc, char *argv[]) {
     filled = GTK_TOGGLE_BUTTON(gtk_builder_get_object(builder,"fill_poly_checkButton"));
     CS_Clipping = GTK_TOGGLE_BUTTON(gtk_builder_get_object(builder,"CS_Clipping"));
     LB_Clipping = GTK_TOGGLE_BUTTON(gtk_builder_get_object(builder,"LB_Clipping"));
+    NLN_Clipping = GTK_TOGGLE_BUTTON(gtk_builder_get_object(builder,"NLN_Clipping"));
+    AUTO_Clipping = GTK_TOGGLE_BUTTON(gtk_builder_get_object(builder,"AUTO_Clipping"));
     g_signal_connect(CS_Clipping, "toggled", G_CALLBACK(check), NULL);
     g_signal_connect(LB_Clipping, "toggled", G_CALLBACK(check), NULL);
+    g_signal_connect(NLN_Clipping, "toggled", G_CALLBACK(check), NULL);
+    g_signal_connect(AUTO_Clipping, "toggled", G_CALLBACK(check), NULL);
     name_curve_entry = GTK_ENTRY(gtk_builder_get_object(builder, "name_curve_entry"));
     x_curve_entry = GTK_ENTRY(gtk_builder_get_object(builder, "x_curve_entry"));
     y_curve_entry = GTK_ENTRY(gtk_builder_get_object(builder, "y_curve_entry"));
@@ -983,6 +1037,11 @@ int main (int argc, char *argv[]) {
     check_perspective = GTK_TOGGLE_BUTTON(gtk_builder_get_object(builder,"check_perspective"));
     g_signal_connect(check_parallel, "toggled", G_CALLBACK(check_parallel_event), NULL);
     g_signal_connect(check_perspective, "toggled", G_CALLBACK(check_perspective_event), NULL);
+    check_zbuffer = GTK_TOGGLE_BUTTON(gtk_builder_get_object(builder,"check_zbuffer"));
+    g_signal_connect(check_zbuffer, "toggled", G_CALLBACK(check_zbuffer_event), NULL);
+    check_backface = GTK_TOGGLE_BUTTON(gtk_builder_get_object(builder,"check_backface"));
+    g_signal_connect(check_backface, "toggled", G_CALLBACK(check_backface_event), NULL);
+    g_signal_connect(objects_select, "changed", G_CALLBACK(objects_select_changed), NULL);
     name_surface_entry = GTK_ENTRY(gtk_builder_get_object(builder, "name_curve_entry"));
     x_surface_entry = GTK_ENTRY(gtk_builder_get_object(builder, "x_surface_entry"));
     y_surface_entry = GTK_ENTRY(gtk_builder_get_object(builder, "y_surface_entry"));
@@ -0,0 +1,132 @@
+#ifndef MAT4_HPP
+#define MAT4_HPP
+
+#include <initializer_list>
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+/*
+	Fixed-size value types for homogeneous coordinates. Nothing here
+	touches the heap: a Vec4 is exactly one AVX register (4 doubles)
+	and a Mat4 is 4 Vec4 rows.
+
+	Same convention as the rest of the project: row vector times
+	matrix, r = v * M
+*/
+struct alignas(32) Vec4 {
+	double v[4];
+
+	double& operator[](int i) { return v[i]; }
+	const double& operator[](int i) const { return v[i]; }
+
+	static constexpr int size() { return 4; }
+};
+
+struct alignas(32) Mat4 {
+	Vec4 rows[4];
+
+	Mat4() : rows{} {}
+
+	Mat4(std::initializer_list<std::initializer_list<double>> m) : rows{} {
+		int i = 0;
+		for (auto &row : m) {
+			int j = 0;
+			for (double value : row)
+				rows[i][j++] = value;
+			i++;
+		}
+	}
+
+	Vec4& operator[](int i) { return rows[i]; }
+	const Vec4& operator[](int i) const { return rows[i]; }
+
+	static constexpr int size() { return 4; }
+
+	static Mat4 identity() {
+		return Mat4({ {1, 0, 0, 0},
+					  {0, 1, 0, 0},
+					  {0, 0, 1, 0},
+					  {0, 0, 0, 1} });
+	}
+};
+
+/* r = v * m */
+inline void mat4_mul_vec(const Vec4& v, const Mat4& m, Vec4& r) {
+#if defined(__AVX__)
+	__m256d acc = _mm256_mul_pd(_mm256_broadcast_sd(&v.v[0]), _mm256_load_pd(m.rows[0].v));
+#if defined(__FMA__)
+	acc = _mm256_fmadd_pd(_mm256_broadcast_sd(&v.v[1]), _mm256_load_pd(m.rows[1].v), acc);
+	acc = _mm256_fmadd_pd(_mm256_broadcast_sd(&v.v[2]), _mm256_load_pd(m.rows[2].v), acc);
+	acc = _mm256_fmadd_pd(_mm256_broadcast_sd(&v.v[3]), _mm256_load_pd(m.rows[3].v), acc);
+#else
+	acc = _mm256_add_pd(acc, _mm256_mul_pd(_mm256_broadcast_sd(&v.v[1]), _mm256_load_pd(m.rows[1].v)));
+	acc = _mm256_add_pd(acc, _mm256_mul_pd(_mm256_broadcast_sd(&v.v[2]), _mm256_load_pd(m.rows[2].v)));
+	acc = _mm256_add_pd(acc, _mm256_mul_pd(_mm256_broadcast_sd(&v.v[3]), _mm256_load_pd(m.rows[3].v)));
+#endif
+	_mm256_store_pd(r.v, acc);
+#elif defined(__SSE2__)
+	// two 128 bit halves per row: [x y] and [z w]
+	__m128d lo = _mm_setzero_pd();
+	__m128d hi = _mm_setzero_pd();
+	for (int j = 0; j < 4; ++j) {
+		__m128d s = _mm_set1_pd(v.v[j]);
+		lo = _mm_add_pd(lo, _mm_mul_pd(s, _mm_load_pd(m.rows[j].v)));
+		hi = _mm_add_pd(hi, _mm_mul_pd(s, _mm_load_pd(m.rows[j].v + 2)));
+	}
+	_mm_store_pd(r.v, lo);
+	_mm_store_pd(r.v + 2, hi);
+#else
+	double res[4];
+	for (int i = 0; i < 4; ++i) {
+		res[i] = v.v[0] * m.rows[0].v[i]
+			   + v.v[1] * m.rows[1].v[i]
+			   + v.v[2] * m.rows[2].v[i]
+			   + v.v[3] * m.rows[3].v[i];
+	}
+	for (int i = 0; i < 4; ++i)
+		r.v[i] = res[i];
+#endif
+}
+
+/* r = v * m, then bring back to w = 1 */
+inline void mat4_mul_vec_project(const Vec4& v, const Mat4& m, Vec4& r) {
+	mat4_mul_vec(v, m, r);
+#if defined(__AVX__)
+	__m256d p = _mm256_load_pd(r.v);
+	_mm256_store_pd(r.v, _mm256_div_pd(p, _mm256_broadcast_sd(&r.v[3])));
+#elif defined(__SSE2__)
+	__m128d w = _mm_set1_pd(r.v[3]);
+	_mm_store_pd(r.v, _mm_div_pd(_mm_load_pd(r.v), w));
+	_mm_store_pd(r.v + 2, _mm_div_pd(_mm_load_pd(r.v + 2), w));
+#else
+	double w = r.v[3];
+	for (int i = 0; i < 4; ++i)
+		r.v[i] /= w;
+#endif
+}
+
+/* r = a * b, one row of a at a time */
+inline void mat4_mul(const Mat4& a, const Mat4& b, Mat4& r) {
+	for (int i = 0; i < 4; ++i)
+		mat4_mul_vec(a.rows[i], b, r.rows[i]);
+}
+
+inline Mat4 mat4_transpose(const Mat4& m) {
+	Mat4 r;
+	for (int i = 0; i < 4; ++i)
+		for (int j = 0; j < 4; ++j)
+			r[i][j] = m[j][i];
+	return r;
+}
+
+inline Mat4 operator*(const Mat4& a, const Mat4& b) {
+	Mat4 r;
+	mat4_mul(a, b, r);
+	return r;
+}
+
+#endif // MAT4_HPP
@@ -2,13 +2,17 @@
 #define OBJECTS_H
 
 #include <string>
+#include <algorithm>
 #include <vector>
 #include <stdexcept>
 #include <iostream>
+#include <map>
+#include <tuple>
 #include "coordinate.hpp"
 #include "Transformation.hpp"
+#include "vertex_batch.hpp"
+#include "bounding_box.hpp"
 
-typedef std::vector<Coordinate> Coordinates;
 typedef std::vector<std::vector<Coordinate>> control_matrix;
 
 enum obj_type { OBJECT,
@@ -22,6 +26,21 @@ enum obj_type { OBJECT,
 				BEZIER_SURFACE,
 				BSPLINE_SURFACE };
 
+/* Newell's normal of the polygon at(0) .. at(n-1): not unit length, and
+   zero for a degenerate polygon */
+template <typename At>
+Coordinate newell_normal(int n, At at) {
+	Coordinate normal(0, 0, 0);
+	for (int i = 0; i < n; ++i) {
+		const Coordinate& p = at(i);
+		const Coordinate& q = at((i + 1) % n);
+		normal[0] += (p[1] - q[1]) * (p[2] + q[2]);
+		normal[1] += (p[2] - q[2]) * (p[0] + q[0]);
+		normal[2] += (p[0] - q[0]) * (p[1] + q[1]);
+	}
+	return normal;
+}
+
 class Object {
 	public:
 		Object(const std::string name) : 
@@ -105,27 +124,50 @@ class Object {
 		}
 
 		virtual void transform_coords(const Transformation& t) {
-			Matrix m = t.get_transformation_matrix();
+			const Matrix& m = t.get_transformation_matrix();
 			for (int i = 0; i < _coords.size(); i++) {
 				_coords[i].transform(m);
-			}	 	  	 	     	  		  	  	    	      	 	
+			}
+			invalidate_bounding_box();	 	  	 	     	  		  	  	    	      	 	
 		}
 
 		virtual void set_normalized_coords(const Transformation& t) {
-			if (_normalized_coords.size() > 0)
-				_normalized_coords.clear();
-			Matrix m = t.get_transformation_matrix();
-			for (int i = 0; i < _coords.size(); i++) {
-				Coordinate normalized_coord = _coords[i];
-				normalized_coord.transform(m);
-				_normalized_coords.push_back(normalized_coord);
-			}
+			// left homogeneous: Clipping divides what is in front of the eye
+			const Matrix& m = t.get_transformation_matrix();
+			_normalized_coords.resize(_coords.size());
+			for (int i = 0; i < _coords.size(); i++)
+				mat4_mul_vec(_coords[i], m, _normalized_coords[i]);
 		}
 
 		void set_normalized_coords(const Coordinates& coords) {
 			_normalized_coords = coords;
 		}
 
+		/* Drops whatever would be drawn, e.g. when the object is culled */
+		virtual void clear_normalized_coords() {
+			_normalized_coords.clear();
+		}
+
+		/* Box around the world coords, recomputed only after they change */
+		const BoundingBox& get_bounding_box() {
+			if (!_bounding_box_valid) {
+				_bounding_box = compute_bounding_box();
+				_bounding_box_valid = true;
+			}
+			return _bounding_box;
+		}
+
+		/* Appends the world coords, in the order scatter_normalized_coords reads them back */
+		virtual void collect_coords(VertexBatch& batch) const {
+			batch.push_back(_coords);
+		}
+
+		virtual void scatter_normalized_coords(const VertexBatch& batch, std::size_t& offset) {
+			_normalized_coords.resize(_coords.size());
+			batch.copy_to(offset, _normalized_coords.data(), _coords.size());
+			offset += _coords.size();
+		}
+
 		friend std::ostream& operator<<(std::ostream& os, const Object& obj) {
 			os << obj.get_name() << ": [";
 			for (auto i = obj._coords.begin(); i != obj._coords.end(); ++i)
@@ -138,24 +180,44 @@ class Object {
 			return os;
 		}
 
-		virtual bool isFilled() { return false; }
+		virtual bool isFilled() const { return false; }
+
+		/* Window generation the normalized coords were computed for, 0 if stale */
+		unsigned long get_normalized_generation() const { return _normalized_generation; }
+		void set_normalized_generation(unsigned long generation) { _normalized_generation = generation; }
 
-		void add_coordinate(const Coordinate& coord) {	 	  	 	     	  		  	  	    	      	 	
+		void add_coordinate(const Coordinate& coord) {
+			invalidate_bounding_box();	 	  	 	     	  		  	  	    	      	 	
 			_coords.push_back(coord);
 		}
 
 	protected:
 		void add_coordinate(double x , double y, double z) {
+			invalidate_bounding_box();
 			_coords.emplace_back(x,y,z);
 		}
 
 		void add_coordinate(const Coordinates& coords) {
+			invalidate_bounding_box();
 			_coords.insert(_coords.end(), coords.begin(), coords.end());
 		}
+
+		virtual BoundingBox compute_bounding_box() const {
+			BoundingBox box;
+			box.extend(_coords);
+			return box;
+		}
+
+		void invalidate_bounding_box() {
+			_bounding_box_valid = false;
+		}
 	private:
 		const std::string _name;
 		Coordinates _coords;
 		Coordinates _normalized_coords;
+		unsigned long _normalized_generation = 0;
+		BoundingBox _bounding_box;
+		bool _bounding_box_valid = false;
 };
 
 class Point : public Object {
@@ -248,7 +310,13 @@ class Polygon : public Object {
 			return "Polygon";
 		}
 
-		virtual bool isFilled() {return _filled;}
+		virtual bool isFilled() const {return _filled;}
+
+		/* World space normal, see newell_normal */
+		Coordinate get_normal() const {
+			const Coordinates& coords = get_coords();
+			return newell_normal(coords.size(), [&](int i) -> const Coordinate& { return coords[i]; });
+		}
 	protected:
 	private:
 		bool _filled;
@@ -270,22 +338,144 @@ class Curve : public Object {
 			return "Curve";
 		}
 
+		/* The control points are the curve's coords: they are what gets
+		   transformed, saved and boxed, the samples only exist normalized */
 		Coordinates& get_control_points() {
-			return _control_points;
+			return get_coords();
+		}
+
+		/* Cubic spans of the curve, 0 for a plain polyline */
+		virtual int span_count() const { return 0; }
+
+		/*
+			Samples the curve straight into its normalized coords through
+			the window matrix m, still homogeneous like every other object's.
+			Each span is split in half until the chord is within tolerance
+			pixels of the curve, (sx, sy) being the pixels per normalized
+			unit; spans whose control points are all off one side of the
+			window, or all within tolerance of each other, become a single
+			segment.
+		*/
+		void tessellate(const Matrix& m, double sx, double sy, double tolerance);
+
+		/* Splines are sampled by tessellate, not normalized with the batch */
+		virtual void collect_coords(VertexBatch& batch) const {
+			if (span_count() == 0)
+				Object::collect_coords(batch);
+		}
+
+		virtual void scatter_normalized_coords(const VertexBatch& batch, std::size_t& offset) {
+			if (span_count() == 0)
+				Object::scatter_normalized_coords(batch, offset);
 		}
 
-		virtual void generate_curve() {}
 	protected:
+		/* First of the 4 control points of span */
+		virtual int span_first(int span) const { return span; }
 
-		void set_control_points(const Coordinates& coords) {
-			_control_points.insert(_control_points.end(), coords.begin(), coords.end());
+		/* B with P(t) = [t^3 t^2 t 1] * B * [p0 p1 p2 p3] on every span */
+		virtual const Matrix& basis() const {
+			static const Matrix m = Matrix::identity(); // no spans to use it
+			return m;
+		}
+
+	private:
+		static const int MIN_DEPTH = 2;
+		static const int MAX_DEPTH = 10;
+
+		struct Flatness {
+			double sx, sy, tolerance;
 		};
 
-		Coordinates _control_points;
-		double _step = 0.02;
+		// control points through the window matrix, not divided
+		Coordinates _window_points;
 
+		static Coordinate sample(const Matrix& coefficients, double t);
+		static bool single_segment(const Matrix& hull, const Flatness& f);
+		void subdivide(const Matrix& coefficients, double t0, const Coordinate& p0,
+					   double t1, const Coordinate& p1, int depth, const Flatness& f);
 };
 
+Coordinate Curve::sample(const Matrix& coefficients, double t) {
+	Coordinate p;
+	Vec4 powers = {{t*t*t, t*t, t, 1}};
+	mat4_mul_vec(powers, coefficients, p);
+	return p;
+}
+
+/* hull is the span's control points through the window matrix, not
+   divided yet; with all of them in front of the eye the curve stays
+   inside their projection */
+bool Curve::single_segment(const Matrix& hull, const Flatness& f) {
+	double min_x = 0, max_x = 0, min_y = 0, max_y = 0;
+	for (int i = 0; i < 4; ++i) {
+		double w = hull[i][3];
+		if (w <= 0)
+			return false;
+		double x = hull[i][0] / w, y = hull[i][1] / w;
+		min_x = i ? std::min(min_x, x) : x;
+		max_x = i ? std::max(max_x, x) : x;
+		min_y = i ? std::min(min_y, y) : y;
+		max_y = i ? std::max(max_y, y) : y;
+	}
+	if (max_x < -1 || min_x > 1 || max_y < -1 || min_y > 1)
+		return true;
+	return (max_x - min_x) * f.sx <= f.tolerance && (max_y - min_y) * f.sy <= f.tolerance;
+}
+
+void Curve::tessellate(const Matrix& m, double sx, double sy, double tolerance) {
+	Coordinates& samples = get_normalized_coords();
+	samples.clear();
+	const Coordinates& points = get_coords();
+	Flatness f = {sx, sy, tolerance};
+
+	// splines commute with m in homogeneous coords: only the control
+	// points go through it, once each, and the divide waits for the samples
+	_window_points.resize(points.size());
+	for (int i = 0; i < points.size(); ++i)
+		mat4_mul_vec(points[i], m, _window_points[i]);
+
+	for (int span = 0; span < span_count(); ++span) {
+		Matrix hull;
+		for (int j = 0; j < 4; ++j)
+			hull[j] = _window_points[span_first(span) + j];
+		Matrix coefficients = basis() * hull;
+
+		Coordinate first = sample(coefficients, 0), last = sample(coefficients, 1);
+		if (span == 0)
+			samples.push_back(first);
+		if (single_segment(hull, f))
+			samples.push_back(last);
+		else
+			subdivide(coefficients, 0, first, 1, last, 0, f);
+	}
+}
+
+/* Appends the samples after p0, up to and including p1. The error is
+   only measured in front of the eye; a piece crossing it is split
+   until the crossing is pinned down for the near plane, and a piece
+   wholly behind it is clipped away whole */
+void Curve::subdivide(const Matrix& coefficients, double t0, const Coordinate& p0,
+					  double t1, const Coordinate& p1, int depth, const Flatness& f) {
+	double t = (t0 + t1) / 2;
+	Coordinate p = sample(coefficients, t);
+	bool split;
+	if (p0[3] > 0 && p[3] > 0 && p1[3] > 0) {
+		double dx = (p[0] / p[3] - (p0[0] / p0[3] + p1[0] / p1[3]) / 2) * f.sx;
+		double dy = (p[1] / p[3] - (p0[1] / p0[3] + p1[1] / p1[3]) / 2) * f.sy;
+		split = dx*dx + dy*dy > f.tolerance * f.tolerance;
+	} else {
+		split = p0[3] > 0 || p[3] > 0 || p1[3] > 0;
+	}
+
+	if (depth < MAX_DEPTH && (depth < MIN_DEPTH || split)) {
+		subdivide(coefficients, t0, p0, t, p, depth + 1, f);
+		subdivide(coefficients, t, p, t1, p1, depth + 1, f);
+	} else {
+		get_normalized_coords().push_back(p1);
+	}
+}
+
 class BezierCurve : public Curve {
 	public:
 		BezierCurve(std::string name) :
@@ -295,8 +485,7 @@ class BezierCurve : public Curve {
 		BezierCurve(std::string name, const Coordinates& coords) :
 			Curve(name)
 		{	 	  	 	     	  		  	  	    	      	 	
-			set_control_points(coords);
-			generate_curve();
+			add_coordinate(coords);
 		}
 
 		virtual ~BezierCurve() {}
@@ -309,35 +498,23 @@ class BezierCurve : public Curve {
 			return "Bezier Curve";
 		}
 
-		virtual void generate_curve() {
-
-			int num_curves = ((_control_points.size() - 4)/3) + 1;
-
-			for (int i = 0; i < num_curves; i++) {
-				for (double t = 0; t < 1; t += _step) {
-					double t2 = t * t;
-					double t3 = t2 * t;
-
-					double x = (-t3 +3*t2 -3*t + 1) * _control_points[i*3+0][0] 
-								+ (3*t3 -6*t2 +3*t) * _control_points[i*3+1][0]
-								+ (-3*t3 +3*t2) * _control_points[i*3+2][0]
-								+ (t3) * _control_points[i*3+3][0];
-
-					double y = (-t3 +3*t2 -3*t + 1) * _control_points[i*3+0][1] 
-								+ (3*t3 -6*t2 +3*t) * _control_points[i*3+1][1]
-								+ (-3*t3 +3*t2) * _control_points[i*3+2][1]
-								+ (t3) * _control_points[i*3+3][1];
-
-					double z = (-t3 +3*t2 -3*t + 1) * _control_points[i*3+0][2] 
-								+ (3*t3 -6*t2 +3*t) * _control_points[i*3+1][2]
-								+ (-3*t3 +3*t2) * _control_points[i*3+2][2]
-								+ (t3) * _control_points[i*3+3][2];
+		/* 4 control points, then 3 more for each further span */
+		virtual int span_count() const {
+			int n = get_coords().size();
+			return n >= 4 ? (n - 1) / 3 : 0;
+		}
 
-					add_coordinate(x,y,z);
-				}	 	  	 	     	  		  	  	    	      	 	
-			}
+		static const Matrix& basis_matrix() {
+			static const Matrix m = { {-1,  3, -3, 1},
+									  { 3, -6,  3, 0},
+									  {-3,  3,  0, 0},
+									  { 1,  0,  0, 0} };
+			return m;
 		}
+
 	protected:
+		virtual int span_first(int span) const { return 3 * span; }
+		virtual const Matrix& basis() const { return basis_matrix(); }
 	private:
 };
 
@@ -349,8 +526,7 @@ class BsplineCurve : public Curve {
 		BsplineCurve(std::string name, const Coordinates& coords) :
 			Curve(name)
 		{
-			set_control_points(coords);
-			generate_curve();
+			add_coordinate(coords);
 		}
 
 		virtual ~BsplineCurve() {}
@@ -361,94 +537,128 @@ class BsplineCurve : public Curve {
 
 		virtual std::string getTypeName() const {
 			return "B-spline Curve";
+		}	 	  	 	     	  		  	  	    	      	 	
+
+		/* one span per 4 consecutive control points */
+		virtual int span_count() const {
+			int n = get_coords().size();
+			return n >= 4 ? n - 3 : 0;
 		}
 
-		virtual void generate_curve() {
-			int num_curves = _control_points.size() - 3;
+		static const Matrix& basis_matrix() {
+			static const Matrix m = { {-1.0/6,  0.5, -0.5, 1.0/6},
+									  { 0.5,   -1.0,  0.5, 0    },
+									  {-0.5,    0,    0.5, 0    },
+									  { 1.0/6,  2.0/3, 1.0/6, 0 } };
+			return m;
+		}
 
-			double t = _step;
-			double t2 = t * _step;
-			double t3 = t2 * _step;
+	protected:
+		virtual const Matrix& basis() const { return basis_matrix(); }
+	private:
+};
 
-			double n16 = 1.0/6.0;
-			double n23 = 2.0/3.0;
+typedef std::vector<Polygon> face_list;
 
+/*
+	Faces of a 3D object as indexes into one shared vertex array, so a
+	vertex used by several faces is stored (and transformed) only once.
+	The index lists of all faces are kept back to back in _indices:
+	face f is _indices[_offsets[f]] .. _indices[_offsets[f+1]-1]
+*/
+class IndexedMesh {
+	public:
+		IndexedMesh() :
+			_offsets(1, 0)
+		{}
 
-			for (int i = 0; i < num_curves; i++) {	 	  	 	     	  		  	  	    	      	 	
-				auto c1 = _control_points[i];
-				auto c2 = _control_points[i+1];
-				auto c3 = _control_points[i+2];
-				auto c4 = _control_points[i+3];
+		Coordinates& get_vertices() {
+			return _vertices;
+		}
 
-				double ax = -n16 * c1[0] +0.5 * c2[0] -0.5 * c3[0] +n16 * c4[0];
-				double bx =  0.5 * c1[0] 	   -c2[0] +0.5 * c3[0];
-				double cx = -0.5 * c1[0] 			  +0.5 * c3[0];
-				double dx =  n16 * c1[0] +n23 * c2[0] +n16 * c3[0];
+		const Coordinates& get_vertices() const {
+			return _vertices;
+		}
 
-				double delta_x  = ax * t3 + bx * t2 + cx * t;
-				double delta_x3 = ax * (6 * t3);
-				double delta_x2 = delta_x3 +bx * (2 * t2);
+		int add_vertex(const Coordinate& c) {
+			_vertices.push_back(c);
+			return _vertices.size()-1;
+		}
 
-				double ay = -n16 * c1[1] +0.5 * c2[1] -0.5 * c3[1] +n16 * c4[1];
-				double by =  0.5 * c1[1] 	   -c2[1] +0.5 * c3[1];
-				double cy = -0.5 * c1[1] 			  +0.5 * c3[1];
-				double dy =  n16 * c1[1] +n23 * c2[1] +n16 * c3[1];
+		void add_face(const std::vector<int>& indices, bool filled = false) {
+			add_face(indices.data(), indices.size(), filled);
+		}
 
-				double delta_y  = ay * t3 + by * t2 + cy * t;
-				double delta_y3 = ay * (6 * t3);
-				double delta_y2 = delta_y3 +by * (2 * t2);
+		void add_face(const int* indices, int count, bool filled = false) {
+			_indices.insert(_indices.end(), indices, indices + count);
+			_offsets.push_back(_indices.size());
+			_filled.push_back(filled);
+		}
 
-				double az = -n16 * c1[2] +0.5 * c2[2] -0.5 * c3[2] +n16 * c4[2];
-				double bz =  0.5 * c1[2] 	   -c2[2] +0.5 * c3[2];
-				double cz = -0.5 * c1[2] 			  +0.5 * c3[2];
-				double dz =  n16 * c1[2] +n23 * c2[2] +n16 * c3[2];
+		void reserve(int vertices, int indices, int faces) {
+			_vertices.reserve(vertices);
+			_indices.reserve(indices);
+			_offsets.reserve(faces+1);
+			_filled.reserve(faces);
+		}
 
-				double delta_z  = az * t3 + bz * t2 + cz * t;
-				double delta_z3 = az * (6 * t3);
-				double delta_z2 = delta_z3 +bz * (2 * t2);
+		int face_count() const {
+			return _offsets.size()-1;
+		}
 
-				double vx = dx, vy = dy, vz = dz;
-				add_coordinate(vx, vy, vz);
-				for (double t = 0.0; t < 1.0; t += _step) {
-					double x = vx, y = vy, z = vz;
+		int face_size(int f) const {
+			return _offsets[f+1] - _offsets[f];
+		}
 
-					x += delta_x;
-					delta_x += delta_x2;
-					delta_x2 += delta_x3;
+		/* Indexes of the vertices of face f, face_size(f) of them */
+		const int* face(int f) const {
+			return _indices.data() + _offsets[f];
+		}
 
-					y += delta_y;
-					delta_y += delta_y2;
-					delta_y2 += delta_y3;
+		bool is_face_filled(int f) const {
+			return _filled[f];
+		}
 
-					z += delta_z;
-					delta_z += delta_z2;
-					delta_z2 += delta_z3;
+		/* World space normal of face f, see newell_normal */
+		Coordinate face_normal(int f) const {
+			const int* idx = face(f);
+			return newell_normal(face_size(f), [&](int i) -> const Coordinate& { return _vertices[idx[i]]; });
+		}
 
-					add_coordinate(x,y,z);
-					vx = x;
-					vy = y;
-					vz = z;
-				}	 	  	 	     	  		  	  	    	      	 	
-			}
+		void clear() {
+			_vertices.clear();
+			_indices.clear();
+			_offsets.assign(1, 0);
+			_filled.clear();
 		}
 	protected:
 	private:
+		Coordinates _vertices;
+		std::vector<int> _indices;
+		std::vector<int> _offsets;
+		std::vector<bool> _filled;
 };
 
-typedef std::vector<Polygon> face_list;
-
 class Object3D : public Object {
 	public:
 		Object3D(const std::string name) :
 			Object(name)
 		{}
 
+		Object3D(const std::string name, const IndexedMesh& mesh) :
+			Object(name),
+			_mesh(mesh)
+		{}
+
+		Object3D(const std::string name, IndexedMesh&& mesh) :
+			Object(name),
+			_mesh(std::move(mesh))
+		{}
+
 		Object3D(const std::string name, const face_list& faces) :
 			Object(name)
 		{
-			for (int i = 0; i < faces.size(); ++i) {
-			    _faces.push_back(faces[i]);   
-			}
+			insert_faces(faces);
 		}
 		virtual ~Object3D() {};
 	
@@ -460,41 +670,57 @@ class Object3D : public Object {
 			return "3D Object";
 		}
 
-		face_list& get_face_list() {
-			return this->_faces;
+		IndexedMesh& get_mesh() {
+			return _mesh;
 		}
 
-		void insert_faces(const face_list& faces) {	 	  	 	     	  		  	  	    	      	 	
-			for (int i = 0; i < faces.size(); ++i) {
-			    _faces.push_back(faces[i]);   
+		/* Normalized (and clipped) coords of every face, in mesh face order */
+		std::vector<Coordinates>& get_normalized_faces() {
+			return _normalized_faces;
+		}
+
+		/* Adds faces given by value, merging vertices with equal coords */
+		void insert_faces(const face_list& faces) {
+			std::map<std::tuple<double, double, double>, int> index_of;
+			for (int i = 0; i < _mesh.get_vertices().size(); ++i) {
+				const auto &v = _mesh.get_vertices()[i];
+				index_of.emplace(std::make_tuple(v[0], v[1], v[2]), i);
+			}
+
+			std::vector<int> indices;
+			for (auto &face : faces) {
+				indices.clear();
+				for (const auto &c : face.get_coords()) {
+					auto key = std::make_tuple(c[0], c[1], c[2]);
+					auto it = index_of.find(key);
+					if (it == index_of.end())
+						it = index_of.emplace(key, _mesh.add_vertex(c)).first;
+					indices.push_back(it->second);
+				}
+				_mesh.add_face(indices, face.isFilled());
 			}
+			invalidate_bounding_box();
 		}
 
 		virtual Coordinate get_center_coord() {
 			Coordinate sum(3);
-			int n = 0;
-			for (auto &face : _faces) {
-				for (auto &coord : face.get_coords()) {
-					sum += coord;
-					
-				}
-				n += face.get_coords().size();
-				
-			}
-			
-			sum[0] /= n;
-			sum[1] /= n;
-			sum[2] /= n;
+			const auto &vertices = _mesh.get_vertices();
+			for (auto &coord : vertices)
+				sum += coord;
+
+			sum[0] /= vertices.size();
+			sum[1] /= vertices.size();
+			sum[2] /= vertices.size();
 			return sum;
 		}
 
 		virtual Coordinate get_normalized_center_coord() {
 			Coordinate sum(3);
 			int n = 0;
-			for (auto &face : _faces) {
-				for (auto &coord : face.get_normalized_coords())
+			for (auto &face : _normalized_faces) {
+				for (auto &coord : face)
 					sum += coord;
-				n += face.get_normalized_coords().size();
+				n += face.size();
 			}
 			sum[0] /= n;
 			sum[1] /= n;
@@ -503,31 +729,98 @@ class Object3D : public Object {
 		}
 
 		virtual void transform_coords(const Transformation& t) {
-			Matrix m = t.get_transformation_matrix();
+			const Matrix& m = t.get_transformation_matrix();
 
-			for (auto &face : _faces) {	 	  	 	     	  		  	  	    	      	 	
-				for (auto &coord : face.get_coords()) {
-					coord.transform(m);
-				}
-			}
+			for (auto &coord : _mesh.get_vertices())
+				coord.transform(m);
+			invalidate_bounding_box();
+		}
+
+		virtual void clear_normalized_coords() {
+			for (auto &face : _normalized_faces)
+				face.clear();
 		}
 
 		virtual void set_normalized_coords(const Transformation& t) {
-			Matrix m = t.get_transformation_matrix();
+			const Matrix& m = t.get_transformation_matrix();
+			const auto &vertices = _mesh.get_vertices();
 
-			for (auto &face : _faces) {
-				auto &coords = face.get_normalized_coords();
-				if (coords.size() > 0)
-					coords.clear();
-				for (auto coord : face.get_coords()) {
-				    coord.transform(m);
-					coords.push_back(coord);
+			_normalized_vertices.resize(vertices.size());
+			for (int i = 0; i < vertices.size(); i++)
+				mat4_mul_vec(vertices[i], m, _normalized_vertices[i]);
+			build_normalized_faces(0, _mesh.face_count());
+		}
+
+		virtual void collect_coords(VertexBatch& batch) const {
+			batch.push_back(_mesh.get_vertices());
+		}
+
+		/* Only the vertices: faces are gathered afterwards by build_normalized_faces,
+		   which can then be split in face ranges */
+		virtual void scatter_normalized_coords(const VertexBatch& batch, std::size_t& offset) {
+			std::size_t n = _mesh.get_vertices().size();
+			_normalized_vertices.resize(n);
+			batch.copy_to(offset, _normalized_vertices.data(), n);
+			offset += n;
+			_normalized_faces.resize(_mesh.face_count());
+		}
+
+		/* Drops faces that point away from the window when normalizing,
+		   which only suits closed meshes with consistent winding */
+		void set_backface_culling(bool cull) {
+			_backface_culling = cull;
+		}
+
+		bool get_backface_culling() const {
+			return _backface_culling;
+		}
+
+		/* Gathers the normalized vertices of faces [begin, end) through their indexes;
+		   with back-face culling, faces seen from behind are left empty */
+		void build_normalized_faces(int begin, int end) {
+			_normalized_faces.resize(_mesh.face_count());
+			for (int f = begin; f < end; ++f) {
+				const int* idx = _mesh.face(f);
+				auto &out = _normalized_faces[f];
+				if (_backface_culling && is_back_face(idx, _mesh.face_size(f))) {
+					out.clear();
+					continue;
 				}
+				out.resize(_mesh.face_size(f));
+				for (int k = 0; k < out.size(); ++k)
+					out[k] = _normalized_vertices[idx[k]];
 			}
 		}
 	protected:
+		virtual BoundingBox compute_bounding_box() const {
+			BoundingBox box;
+			box.extend(_mesh.get_vertices());
+			return box;
+		}
 	private:
-		face_list _faces;
+		/* Winding of the face once projected: the window looks down +z
+		   with y up, so a face whose vertices are counterclockwise
+		   around its outward normal turns clockwise when seen from the
+		   front, and counterclockwise from behind. Faces reaching behind
+		   the eye have no projected winding and are left to Clipping */
+		bool is_back_face(const int* idx, int n) const {
+			double area = 0;
+			for (int i = 0; i < n; ++i) {
+				const Coordinate& p = _normalized_vertices[idx[i]];
+				const Coordinate& q = _normalized_vertices[idx[(i + 1) % n]];
+				if (p[3] <= 0)
+					return false;
+				double px = p[0] / p[3], py = p[1] / p[3];
+				double qx = q[0] / q[3], qy = q[1] / q[3];
+				area += px * qy - qx * py;
+			}
+			return area > 0;
+		}
+
+		IndexedMesh _mesh;
+		Coordinates _normalized_vertices;
+		std::vector<Coordinates> _normalized_faces;
+		bool _backface_culling = false;
 };
 
 typedef std::vector<Curve> curve_list;
@@ -554,29 +847,57 @@ class Surface : public Object
         Coordinates& get_control_points(){ return m_controlPoints; }
 
         virtual void transform_coords(const Transformation& t) {
-			Matrix m = t.get_transformation_matrix();
+			const Matrix& m = t.get_transformation_matrix();
 
+			for (auto &coord : m_controlPoints)
+				coord.transform(m);
 			for (auto &curve : m_curveList) {
 				for (auto &coord : curve.get_coords()) {
 					coord.transform(m);
 				}
 			}
+			invalidate_bounding_box();
+		}
+
+		virtual void clear_normalized_coords() {
+			for (auto &curve : m_curveList)
+				curve.get_normalized_coords().clear();
 		}
 
 		virtual void set_normalized_coords(const Transformation& t) {
-			Matrix m = t.get_transformation_matrix();
+			const Matrix& m = t.get_transformation_matrix();
+			if (m_patchStep > 0) {
+				normalizePatches(m);
+				return;
+			}
 
 			for (auto &curve : m_curveList) {
 				auto &coords = curve.get_normalized_coords();
 				if (coords.size() > 0)
 					coords.clear();
-				for (auto coord : curve.get_coords()) {
-				    coord.transform(m);
-					coords.push_back(coord);
+				for (const auto &coord : curve.get_coords()) {
+					coords.emplace_back();
+					mat4_mul_vec(coord, m, coords.back());
 				}
 			}
 		}
 
+		/* Surfaces made of patches are normalized from their control
+		   points by set_normalized_coords, not with the batch */
+		virtual void collect_coords(VertexBatch& batch) const {
+			if (m_patchStep > 0)
+				return;
+			for (const auto &curve : m_curveList)
+				batch.push_back(curve.get_coords());
+		}
+
+		virtual void scatter_normalized_coords(const VertexBatch& batch, std::size_t& offset) {
+			if (m_patchStep > 0)
+				return;
+			for (auto &curve : m_curveList)
+				curve.scatter_normalized_coords(batch, offset);
+		}
+
 		virtual Coordinate get_center_coord() {
 			Coordinate sum(3);
 			int n = 0;
@@ -615,10 +936,35 @@ class Surface : public Object
         int getMaxCols(){ return m_maxCols; }
 
     protected:
+		virtual BoundingBox compute_bounding_box() const {
+			BoundingBox box;
+			for (const auto &curve : m_curveList)
+				box.extend(curve.get_coords());
+			return box;
+		}
+
         void setControlPoints(const Coordinates& coords) {
 			m_controlPoints.insert(m_controlPoints.end(), coords.begin(), coords.end());
 		}
 
+		/*
+			Adds the curves of constant s and of constant t of every patch,
+			the 4x4 blocks of control points step rows/columns apart. A
+			patch is S(s,t) = [s^3 s^2 s 1] * B * G * B^T * [t^3 t^2 t 1]^T,
+			so B * G * B^T (per coordinate) is computed once per patch and
+			every sample of the grid, evaluated once for both families,
+			costs one dot product per coordinate.
+		*/
+		void generatePatches(const Matrix& basis, int step);
+
+		/* The curves of generatePatches, in normalized coords: only the
+		   control points go through m, the patches are sampled after */
+		void normalizePatches(const Matrix& m);
+
+		/* Samples the patch at (row, col) of points on an (n+1) x (n+1)
+		   grid, n = 1/m_step; with homogeneous, w too (not divided) */
+		void samplePatch(const Coordinates& points, int row, int col, bool homogeneous, Coordinates& grid) const;
+
     protected:
             //Guarda os pontos de controle da surface
             // para serem usados na hora de salvar a surface no .obj
@@ -627,8 +973,112 @@ class Surface : public Object
 
             int m_maxLines = 4, m_maxCols = 4;
             curve_list m_curveList;
+
+            // set by generatePatches; 0 if the curves did not come from patches
+            Matrix m_basis;
+            int m_patchStep = 0;
+            std::vector<Vec4> m_powers; // [t^3 t^2 t 1] of every sample
+            Coordinates m_normalizedPoints, m_grid;
 };
 
+void Surface::generatePatches(const Matrix& basis, int step) {
+	m_basis = basis;
+	m_patchStep = step;
+	int n = std::max(1, (int) std::lround(1 / m_step));
+	m_powers.resize(n + 1);
+	for (int i = 0; i <= n; ++i) {
+		double t = (double) i / n;
+		m_powers[i] = {{t*t*t, t*t, t, 1}};
+	}
+
+	int patches = 0;
+	for (int row = 0; row + 3 < m_maxLines; row += step)
+		for (int col = 0; col + 3 < m_maxCols; col += step)
+			++patches;
+	m_curveList.reserve(m_curveList.size() + patches * 2 * (n + 1));
+
+	for (int row = 0; row + 3 < m_maxLines; row += step) {
+		for (int col = 0; col + 3 < m_maxCols; col += step) {
+			samplePatch(m_controlPoints, row, col, false, m_grid);
+			for (int i = 0; i <= n; ++i) {
+				std::string name = "curve" + std::to_string((double) i / n);
+				Curve s_curve(name), t_curve(name);
+				s_curve.get_coords().reserve(n + 1);
+				t_curve.get_coords().reserve(n + 1);
+				for (int j = 0; j <= n; ++j) {
+					s_curve.add_coordinate(m_grid[i * (n + 1) + j]);
+					t_curve.add_coordinate(m_grid[j * (n + 1) + i]);
+				}
+				m_curveList.push_back(std::move(s_curve));
+				m_curveList.push_back(std::move(t_curve));
+			}
+		}
+	}
+	invalidate_bounding_box();
+}
+
+/*
+	Splines commute with m in homogeneous coords, so this is exact for
+	both views. Under a parallel view w stays 1 and only x, y and z are
+	sampled; a perspective matrix also needs w, which Clipping divides
+	out like everyone else's.
+*/
+void Surface::normalizePatches(const Matrix& m) {
+	bool homogeneous = m[0][3] != 0 || m[1][3] != 0 || m[2][3] != 0 || m[3][3] != 1;
+	m_normalizedPoints.resize(m_controlPoints.size());
+	for (int i = 0; i < m_controlPoints.size(); ++i)
+		mat4_mul_vec(m_controlPoints[i], m, m_normalizedPoints[i]);
+
+	int n = m_powers.size() - 1;
+	int c = 0;
+	for (int row = 0; row + 3 < m_maxLines; row += m_patchStep) {
+		for (int col = 0; col + 3 < m_maxCols; col += m_patchStep) {
+			samplePatch(m_normalizedPoints, row, col, homogeneous, m_grid);
+			for (int i = 0; i <= n; ++i) {
+				Coordinates& s_curve = m_curveList[c++].get_normalized_coords();
+				Coordinates& t_curve = m_curveList[c++].get_normalized_coords();
+				s_curve.resize(n + 1);
+				t_curve.resize(n + 1);
+				for (int j = 0; j <= n; ++j) {
+					s_curve[j] = m_grid[i * (n + 1) + j];
+					t_curve[j] = m_grid[j * (n + 1) + i];
+				}
+			}
+		}
+	}
+}
+
+void Surface::samplePatch(const Coordinates& points, int row, int col, bool homogeneous, Coordinates& grid) const {
+	int n = m_powers.size() - 1;
+	int axes = homogeneous ? 4 : 3;
+	Matrix basis_t = mat4_transpose(m_basis);
+	Matrix coefficients[4];
+	for (int axis = 0; axis < axes; ++axis) {
+		Matrix g;
+		for (int i = 0; i < 4; ++i)
+			for (int k = 0; k < 4; ++k)
+				g[i][k] = points[(row + i) * m_maxCols + col + k][axis];
+		coefficients[axis] = m_basis * g * basis_t;
+	}
+
+	grid.resize((n + 1) * (n + 1));
+	for (int i = 0; i <= n; ++i) {
+		// row i is the cubic [t^3 t^2 t 1] * row, row[k][axis] being
+		// what the s part of the patch leaves for t^(3-k) on that axis
+		Matrix row;
+		row[3][3] = 1; // w = 1 when it is not sampled
+		for (int axis = 0; axis < axes; ++axis) {
+			Vec4 a;
+			mat4_mul_vec(m_powers[i], coefficients[axis], a);
+			for (int k = 0; k < 4; ++k)
+				row[k][axis] = a[k];
+		}
+		Coordinate* p = &grid[i * (n + 1)];
+		for (int j = 0; j <= n; ++j)
+			mat4_mul_vec(m_powers[j], row, p[j]);
+	}
+}
+
 //http://www.cad[2]ju.edu.cn/home/zhx/GM/005/00-bcs2.pdf
 class BezierSurface : public Surface
 {
@@ -655,61 +1105,8 @@ class BezierSurface : public Surface
 				return;
 
 			setControlPoints(cpCoords);
-			const auto& coords = m_controlPoints;
-
-			int tmp3xMaxLines = 3*m_maxLines,
-				tmp3xMaxCols = 3*m_maxCols;
-			for(int nLine = 0; (m_maxLines != 4 && nLine <= tmp3xMaxLines) ||
-					(nLine < tmp3xMaxLines); nLine += tmp3xMaxCols){
-				for(int nCol = 0; nCol < m_maxCols-1; nCol += 3){
-
-					for(float s = 0.0; s <= 1.0; s += m_step){
-						double s2 = s * s;
-						double s3 = s2 * s;
-
-						BezierCurve curve("curve"+std::to_string(s));
-						for(float t = 0.0; t <= 1.0; t += m_step){
-							double t2 = t * t;
-							double t3 = t2 * t;
-
-							curve.add_coordinate(blendingFunction(s,s2,s3,t,t2,t3,nLine,nCol,coords));
-						}
-						m_curveList.push_back(curve);
-					}
-
-					for(float t = 0.0; t <= 1.0; t += m_step){
-						double t2 = t * t;
-						double t3 = t2 * t;
-
-						BezierCurve curve("curve"+std::to_string(t));
-						for(float s = 0.0; s <= 1.0; s += m_step){
-							double s2 = s * s;
-							double s3 = s2 * s;
-
-							curve.add_coordinate(blendingFunction(s,s2,s3,t,t2,t3,nLine,nCol,coords));
-						}
-						m_curveList.push_back(curve);
-					}
-				}
-			}
-		}
-        Coordinate blendingFunction(float s, double s2, double s3, float t, double t2, double t3, int nLine, int nCol, const Coordinates& coords) {
-			double x = (-((-s3 +3*s2 -3*s +1)*coords[0+nLine+nCol][0] +(3*s3 -6*s2 +3*s)*coords[m_maxCols+nLine+nCol][0]   +(-3*s3 +3*s2)*coords[m_maxCols*2+nLine+nCol][0]   +(s3)*coords[m_maxCols*3+nLine+nCol][0]) +3*((-s3 +3*s2 -3*s +1)*coords[1+nLine+nCol][0] +(3*s3 -6*s2 +3*s)*coords[m_maxCols+1+nLine+nCol][0] +(-3*s3 +3*s2)*coords[m_maxCols*2+1+nLine+nCol][0] +(s3)*coords[m_maxCols*3+1+nLine+nCol][0]) -3*((-s3 +3*s2 -3*s +1)*coords[2+nLine+nCol][0] +(3*s3 -6*s2 +3*s)*coords[m_maxCols+2+nLine+nCol][0] +(-3*s3 +3*s2)*coords[m_maxCols*2+2+nLine+nCol][0] +(s3)*coords[m_maxCols*3+2+nLine+nCol][0]) +((-s3 +3*s2 -3*s +1)*coords[3+nLine+nCol][0] +(3*s3 -6*s2 +3*s)*coords[m_maxCols+3+nLine+nCol][0] +(-3*s3 +3*s2)*coords[m_maxCols*2+3+nLine+nCol][0] +(s3)*coords[m_maxCols*3+3+nLine+nCol][0]))*t3
-						+(3*((-s3 +3*s2 -3*s +1)*coords[0+nLine+nCol][0] +(3*s3 -6*s2 +3*s)*coords[m_maxCols+nLine+nCol][0]   +(-3*s3 +3*s2)*coords[m_maxCols*2+nLine+nCol][0]   +(s3)*coords[m_maxCols*3+nLine+nCol][0]) -6*((-s3 +3*s2 -3*s +1)*coords[1+nLine+nCol][0] +(3*s3 -6*s2 +3*s)*coords[m_maxCols+1+nLine+nCol][0] +(-3*s3 +3*s2)*coords[m_maxCols*2+1+nLine+nCol][0] +(s3)*coords[m_maxCols*3+1+nLine+nCol][0]) +3*((-s3 +3*s2 -3*s +1)*coords[2+nLine+nCol][0] +(3*s3 -6*s2 +3*s)*coords[m_maxCols+2+nLine+nCol][0] +(-3*s3 +3*s2)*coords[m_maxCols*2+2+nLine+nCol][0] +(s3)*coords[m_maxCols*3+2+nLine+nCol][0]))*t2
-						+(-3*((-s3 +3*s2 -3*s +1)*coords[0+nLine+nCol][0] +(3*s3 -6*s2 +3*s)*coords[m_maxCols+nLine+nCol][0]   +(-3*s3 +3*s2)*coords[m_maxCols*2+nLine+nCol][0]   +(s3)*coords[m_maxCols*3+nLine+nCol][0]) +3*((-s3 +3*s2 -3*s +1)*coords[1+nLine+nCol][0] +(3*s3 -6*s2 +3*s)*coords[m_maxCols+1+nLine+nCol][0] +(-3*s3 +3*s2)*coords[m_maxCols*2+1+nLine+nCol][0] +(s3)*coords[m_maxCols*3+1+nLine+nCol][0]))*t
-						+(((-s3 +3*s2 -3*s +1)*coords[0+nLine+nCol][0] +(3*s3 -6*s2 +3*s)*coords[m_maxCols+nLine+nCol][0]   +(-3*s3 +3*s2)*coords[m_maxCols*2+nLine+nCol][0]   +(s3)*coords[m_maxCols*3+nLine+nCol][0]));
-
-			double y = (-((-s3 +3*s2 -3*s +1)*coords[0+nLine+nCol][1] +(3*s3 -6*s2 +3*s)*coords[m_maxCols+nLine+nCol][1]   +(-3*s3 +3*s2)*coords[m_maxCols*2+nLine+nCol][1]   +(s3)*coords[m_maxCols*3+nLine+nCol][1]) +3*((-s3 +3*s2 -3*s +1)*coords[1+nLine+nCol][1] +(3*s3 -6*s2 +3*s)*coords[m_maxCols+1+nLine+nCol][1] +(-3*s3 +3*s2)*coords[m_maxCols*2+1+nLine+nCol][1] +(s3)*coords[m_maxCols*3+1+nLine+nCol][1]) -3*((-s3 +3*s2 -3*s +1)*coords[2+nLine+nCol][1] +(3*s3 -6*s2 +3*s)*coords[m_maxCols+2+nLine+nCol][1] +(-3*s3 +3*s2)*coords[m_maxCols*2+2+nLine+nCol][1] +(s3)*coords[m_maxCols*3+2+nLine+nCol][1]) +((-s3 +3*s2 -3*s +1)*coords[3+nLine+nCol][1] +(3*s3 -6*s2 +3*s)*coords[m_maxCols+3+nLine+nCol][1] +(-3*s3 +3*s2)*coords[m_maxCols*2+3+nLine+nCol][1] +(s3)*coords[m_maxCols*3+3+nLine+nCol][1]))*t3
-						+(3*((-s3 +3*s2 -3*s +1)*coords[0+nLine+nCol][1] +(3*s3 -6*s2 +3*s)*coords[m_maxCols+nLine+nCol][1]   +(-3*s3 +3*s2)*coords[m_maxCols*2+nLine+nCol][1]   +(s3)*coords[m_maxCols*3+nLine+nCol][1]) -6*((-s3 +3*s2 -3*s +1)*coords[1+nLine+nCol][1] +(3*s3 -6*s2 +3*s)*coords[m_maxCols+1+nLine+nCol][1] +(-3*s3 +3*s2)*coords[m_maxCols*2+1+nLine+nCol][1] +(s3)*coords[m_maxCols*3+1+nLine+nCol][1]) +3*((-s3 +3*s2 -3*s +1)*coords[2+nLine+nCol][1] +(3*s3 -6*s2 +3*s)*coords[m_maxCols+2+nLine+nCol][1] +(-3*s3 +3*s2)*coords[m_maxCols*2+2+nLine+nCol][1] +(s3)*coords[m_maxCols*3+2+nLine+nCol][1]))*t2
-						+(-3*((-s3 +3*s2 -3*s +1)*coords[0+nLine+nCol][1] +(3*s3 -6*s2 +3*s)*coords[m_maxCols+nLine+nCol][1]   +(-3*s3 +3*s2)*coords[m_maxCols*2+nLine+nCol][1]   +(s3)*coords[m_maxCols*3+nLine+nCol][1]) +3*((-s3 +3*s2 -3*s +1)*coords[1+nLine+nCol][1] +(3*s3 -6*s2 +3*s)*coords[m_maxCols+1+nLine+nCol][1] +(-3*s3 +3*s2)*coords[m_maxCols*2+1+nLine+nCol][1] +(s3)*coords[m_maxCols*3+1+nLine+nCol][1]))*t
-						+(((-s3 +3*s2 -3*s +1)*coords[0+nLine+nCol][1] +(3*s3 -6*s2 +3*s)*coords[m_maxCols+nLine+nCol][1]   +(-3*s3 +3*s2)*coords[m_maxCols*2+nLine+nCol][1]   +(s3)*coords[m_maxCols*3+nLine+nCol][1]));
-						
-			double z = (-((-s3 +3*s2 -3*s +1)*coords[0+nLine+nCol][2] +(3*s3 -6*s2 +3*s)*coords[m_maxCols+nLine+nCol][2]   +(-3*s3 +3*s2)*coords[m_maxCols*2+nLine+nCol][2]   +(s3)*coords[m_maxCols*3+nLine+nCol][2]) +3*((-s3 +3*s2 -3*s +1)*coords[1+nLine+nCol][2] +(3*s3 -6*s2 +3*s)*coords[m_maxCols+1+nLine+nCol][2] +(-3*s3 +3*s2)*coords[m_maxCols*2+1+nLine+nCol][2] +(s3)*coords[m_maxCols*3+1+nLine+nCol][2]) -3*((-s3 +3*s2 -3*s +1)*coords[2+nLine+nCol][2] +(3*s3 -6*s2 +3*s)*coords[m_maxCols+2+nLine+nCol][2] +(-3*s3 +3*s2)*coords[m_maxCols*2+2+nLine+nCol][2] +(s3)*coords[m_maxCols*3+2+nLine+nCol][2]) +((-s3 +3*s2 -3*s +1)*coords[3+nLine+nCol][2] +(3*s3 -6*s2 +3*s)*coords[m_maxCols+3+nLine+nCol][2] +(-3*s3 +3*s2)*coords[m_maxCols*2+3+nLine+nCol][2] +(s3)*coords[m_maxCols*3+3+nLine+nCol][2]))*t3
-						+(3*((-s3 +3*s2 -3*s +1)*coords[0+nLine+nCol][2] +(3*s3 -6*s2 +3*s)*coords[m_maxCols+nLine+nCol][2]   +(-3*s3 +3*s2)*coords[m_maxCols*2+nLine+nCol][2]   +(s3)*coords[m_maxCols*3+nLine+nCol][2]) -6*((-s3 +3*s2 -3*s +1)*coords[1+nLine+nCol][2] +(3*s3 -6*s2 +3*s)*coords[m_maxCols+1+nLine+nCol][2] +(-3*s3 +3*s2)*coords[m_maxCols*2+1+nLine+nCol][2] +(s3)*coords[m_maxCols*3+1+nLine+nCol][2]) +3*((-s3 +3*s2 -3*s +1)*coords[2+nLine+nCol][2] +(3*s3 -6*s2 +3*s)*coords[m_maxCols+2+nLine+nCol][2] +(-3*s3 +3*s2)*coords[m_maxCols*2+2+nLine+nCol][2] +(s3)*coords[m_maxCols*3+2+nLine+nCol][2]))*t2
-						+(-3*((-s3 +3*s2 -3*s +1)*coords[0+nLine+nCol][2] +(3*s3 -6*s2 +3*s)*coords[m_maxCols+nLine+nCol][2]   +(-3*s3 +3*s2)*coords[m_maxCols*2+nLine+nCol][2]   +(s3)*coords[m_maxCols*3+nLine+nCol][2]) +3*((-s3 +3*s2 -3*s +1)*coords[1+nLine+nCol][2] +(3*s3 -6*s2 +3*s)*coords[m_maxCols+1+nLine+nCol][2] +(-3*s3 +3*s2)*coords[m_maxCols*2+1+nLine+nCol][2] +(s3)*coords[m_maxCols*3+1+nLine+nCol][2]))*t
-						+(((-s3 +3*s2 -3*s +1)*coords[0+nLine+nCol][2] +(3*s3 -6*s2 +3*s)*coords[m_maxCols+nLine+nCol][2]   +(-3*s3 +3*s2)*coords[m_maxCols*2+nLine+nCol][2]   +(s3)*coords[m_maxCols*3+nLine+nCol][2]));
-
-			return Coordinate(x,y,z);
+			// patches share their border rows and columns of control points
+			generatePatches(BezierCurve::basis_matrix(), 3);
 		}
 };
 
@@ -731,62 +1128,8 @@ class BSplineSurface : public Surface
 				return;
 
 			setControlPoints(cpCoords);
-			const auto& coords = m_controlPoints;
-
-			double n16 = 1.0/6.0;
-			double n23 = 2.0/3.0;
-
-			for(int nLine = 0; (m_maxLines != 4 && nLine <= m_maxLines) ||
-						(nLine < m_maxLines); nLine += m_maxCols){
-				for(int nCol = 0; nCol <= m_maxCols-4; nCol += 1){
-
-					for(float s = 0.0; s <= 1.0; s += m_step){
-						double s2 = s * s;
-						double s3 = s2 * s;
-
-						BsplineCurve curve("curve"+std::to_string(s));
-						for(float t = 0.0; t <= 1.0; t += m_step){
-							double t2 = t * t;
-							double t3 = t2 * t;
-
-							curve.add_coordinate(blendingFunction(s,s2,s3,t,t2,t3,n16,n23,nLine,nCol,coords));
-						}
-						m_curveList.push_back(curve);
-					}
-
-					for(float t = 0.0; t <= 1.0; t += m_step){
-						double t2 = t * t;
-						double t3 = t2 * t;
-
-						BsplineCurve curve("curve"+std::to_string(t));
-						for(float s = 0.0; s <= 1.0; s += m_step){
-							double s2 = s * s;
-							double s3 = s2 * s;
-
-							curve.add_coordinate(blendingFunction(s,s2,s3,t,t2,t3,n16,n23,nLine,nCol,coords));
-						}
-						m_curveList.push_back(curve);
-					}
-				}
-			}
-		}
-		Coordinate blendingFunction(float s, double s2, double s3, float t, double t2, double t3, double n16, double n23, int nLine, int nCol, const Coordinates& coords) {
-			double x = (-n16*((-n16*s3 +0.5*s2 -0.5*s +n16)*coords[0+nLine+nCol][0] +(0.5*s3 -s2 +n23)*coords[m_maxCols+nLine+nCol][0]   +(-0.5*s3 +0.5*s2 +0.5*s +n16)*coords[m_maxCols*2+nLine+nCol][0]   +(n16*s3)*coords[m_maxCols*3+nLine+nCol][0]) +0.5*((-n16*s3 +0.5*s2 -0.5*s +n16)*coords[1+nLine+nCol][0] +(0.5*s3 -s2 +n23)*coords[m_maxCols+1+nLine+nCol][0] +(-0.5*s3 +0.5*s2 +0.5*s +n16)*coords[m_maxCols*2+1+nLine+nCol][0] +(n16*s3)*coords[m_maxCols*3+1+nLine+nCol][0]) -0.5*((-n16*s3 +0.5*s2 -0.5*s +n16)*coords[2+nLine+nCol][0] +(0.5*s3 -s2 +n23)*coords[m_maxCols+2+nLine+nCol][0] +(-0.5*s3 +0.5*s2 +0.5*s +n16)*coords[m_maxCols*2+2+nLine+nCol][0] +(n16*s3)*coords[m_maxCols*3+2+nLine+nCol][0]) +n16*((-n16*s3 +0.5*s2 -0.5*s +n16)*coords[3+nLine+nCol][0] +(0.5*s3 -s2 +n23)*coords[m_maxCols+3+nLine+nCol][0] +(-0.5*s3 +0.5*s2 +0.5*s +n16)*coords[m_maxCols*2+3+nLine+nCol][0] +(n16*s3)*coords[m_maxCols*3+3+nLine+nCol][0]))*t3
-						+(0.5*((-n16*s3 +0.5*s2 -0.5*s +n16)*coords[0+nLine+nCol][0] +(0.5*s3 -s2 +n23)*coords[m_maxCols+nLine+nCol][0]   +(-0.5*s3 +0.5*s2 +0.5*s +n16)*coords[m_maxCols*2+nLine+nCol][0]   +(n16*s3)*coords[m_maxCols*3+nLine+nCol][0]) -((-n16*s3 +0.5*s2 -0.5*s +n16)*coords[1+nLine+nCol][0] +(0.5*s3 -s2 +n23)*coords[m_maxCols+1+nLine+nCol][0] +(-0.5*s3 +0.5*s2 +0.5*s +n16)*coords[m_maxCols*2+1+nLine+nCol][0] +(n16*s3)*coords[m_maxCols*3+1+nLine+nCol][0]) +0.5*((-n16*s3 +0.5*s2 -0.5*s +n16)*coords[2+nLine+nCol][0] +(0.5*s3 -s2 +n23)*coords[m_maxCols+2+nLine+nCol][0] +(-0.5*s3 +0.5*s2 +0.5*s +n16)*coords[m_maxCols*2+2+nLine+nCol][0] +(n16*s3)*coords[m_maxCols*3+2+nLine+nCol][0]))*t2
-						+(-0.5*((-n16*s3 +0.5*s2 -0.5*s +n16)*coords[0+nLine+nCol][0] +(0.5*s3 -s2 +n23)*coords[m_maxCols+nLine+nCol][0]   +(-0.5*s3 +0.5*s2 +0.5*s +n16)*coords[m_maxCols*2+nLine+nCol][0]   +(n16*s3)*coords[m_maxCols*3+nLine+nCol][0]) +0.5*((-n16*s3 +0.5*s2 -0.5*s +n16)*coords[2+nLine+nCol][0] +(0.5*s3 -s2 +n23)*coords[m_maxCols+2+nLine+nCol][0] +(-0.5*s3 +0.5*s2 +0.5*s +n16)*coords[m_maxCols*2+2+nLine+nCol][0] +(n16*s3)*coords[m_maxCols*3+2+nLine+nCol][0]))*t
-						+(n16*((-n16*s3 +0.5*s2 -0.5*s +n16)*coords[0+nLine+nCol][0] +(0.5*s3 -s2 +n23)*coords[m_maxCols+nLine+nCol][0]   +(-0.5*s3 +0.5*s2 +0.5*s +n16)*coords[m_maxCols*2+nLine+nCol][0]   +(n16*s3)*coords[m_maxCols*3+nLine+nCol][0]) +n23*((-n16*s3 +0.5*s2 -0.5*s +n16)*coords[1+nLine+nCol][0] +(0.5*s3 -s2 +n23)*coords[m_maxCols+1+nLine+nCol][0] +(-0.5*s3 +0.5*s2 +0.5*s +n16)*coords[m_maxCols*2+1+nLine+nCol][0] +(n16*s3)*coords[m_maxCols*3+1+nLine+nCol][0]) +n16*((-n16*s3 +0.5*s2 -0.5*s +n16)*coords[2+nLine+nCol][0] +(0.5*s3 -s2 +n23)*coords[m_maxCols+2+nLine+nCol][0] +(-0.5*s3 +0.5*s2 +0.5*s +n16)*coords[m_maxCols*2+2+nLine+nCol][0] +(n16*s3)*coords[m_maxCols*3+2+nLine+nCol][0]));
-						
-			double y = (-n16*((-n16*s3 +0.5*s2 -0.5*s +n16)*coords[0+nLine+nCol][1] +(0.5*s3 -s2 +n23)*coords[m_maxCols+nLine+nCol][1]   +(-0.5*s3 +0.5*s2 +0.5*s +n16)*coords[m_maxCols*2+nLine+nCol][1]   +(n16*s3)*coords[m_maxCols*3+nLine+nCol][1]) +0.5*((-n16*s3 +0.5*s2 -0.5*s +n16)*coords[1+nLine+nCol][1] +(0.5*s3 -s2 +n23)*coords[m_maxCols+1+nLine+nCol][1] +(-0.5*s3 +0.5*s2 +0.5*s +n16)*coords[m_maxCols*2+1+nLine+nCol][1] +(n16*s3)*coords[m_maxCols*3+1+nLine+nCol][1]) -0.5*((-n16*s3 +0.5*s2 -0.5*s +n16)*coords[2+nLine+nCol][1] +(0.5*s3 -s2 +n23)*coords[m_maxCols+2+nLine+nCol][1] +(-0.5*s3 +0.5*s2 +0.5*s +n16)*coords[m_maxCols*2+2+nLine+nCol][1] +(n16*s3)*coords[m_maxCols*3+2+nLine+nCol][1]) +n16*((-n16*s3 +0.5*s2 -0.5*s +n16)*coords[3+nLine+nCol][1] +(0.5*s3 -s2 +n23)*coords[m_maxCols+3+nLine+nCol][1] +(-0.5*s3 +0.5*s2 +0.5*s +n16)*coords[m_maxCols*2+3+nLine+nCol][1] +(n16*s3)*coords[m_maxCols*3+3+nLine+nCol][1]))*t3
-						+(0.5*((-n16*s3 +0.5*s2 -0.5*s +n16)*coords[0+nLine+nCol][1] +(0.5*s3 -s2 +n23)*coords[m_maxCols+nLine+nCol][1]   +(-0.5*s3 +0.5*s2 +0.5*s +n16)*coords[m_maxCols*2+nLine+nCol][1]   +(n16*s3)*coords[m_maxCols*3+nLine+nCol][1]) -((-n16*s3 +0.5*s2 -0.5*s +n16)*coords[1+nLine+nCol][1] +(0.5*s3 -s2 +n23)*coords[m_maxCols+1+nLine+nCol][1] +(-0.5*s3 +0.5*s2 +0.5*s +n16)*coords[m_maxCols*2+1+nLine+nCol][1] +(n16*s3)*coords[m_maxCols*3+1+nLine+nCol][1]) +0.5*((-n16*s3 +0.5*s2 -0.5*s +n16)*coords[2+nLine+nCol][1] +(0.5*s3 -s2 +n23)*coords[m_maxCols+2+nLine+nCol][1] +(-0.5*s3 +0.5*s2 +0.5*s +n16)*coords[m_maxCols*2+2+nLine+nCol][1] +(n16*s3)*coords[m_maxCols*3+2+nLine+nCol][1]))*t2
-						+(-0.5*((-n16*s3 +0.5*s2 -0.5*s +n16)*coords[0+nLine+nCol][1] +(0.5*s3 -s2 +n23)*coords[m_maxCols+nLine+nCol][1]   +(-0.5*s3 +0.5*s2 +0.5*s +n16)*coords[m_maxCols*2+nLine+nCol][1]   +(n16*s3)*coords[m_maxCols*3+nLine+nCol][1]) +0.5*((-n16*s3 +0.5*s2 -0.5*s +n16)*coords[2+nLine+nCol][1] +(0.5*s3 -s2 +n23)*coords[m_maxCols+2+nLine+nCol][1] +(-0.5*s3 +0.5*s2 +0.5*s +n16)*coords[m_maxCols*2+2+nLine+nCol][1] +(n16*s3)*coords[m_maxCols*3+2+nLine+nCol][1]))*t
-						+(n16*((-n16*s3 +0.5*s2 -0.5*s +n16)*coords[0+nLine+nCol][1] +(0.5*s3 -s2 +n23)*coords[m_maxCols+nLine+nCol][1]   +(-0.5*s3 +0.5*s2 +0.5*s +n16)*coords[m_maxCols*2+nLine+nCol][1]   +(n16*s3)*coords[m_maxCols*3+nLine+nCol][1]) +n23*((-n16*s3 +0.5*s2 -0.5*s +n16)*coords[1+nLine+nCol][1] +(0.5*s3 -s2 +n23)*coords[m_maxCols+1+nLine+nCol][1] +(-0.5*s3 +0.5*s2 +0.5*s +n16)*coords[m_maxCols*2+1+nLine+nCol][1] +(n16*s3)*coords[m_maxCols*3+1+nLine+nCol][1]) +n16*((-n16*s3 +0.5*s2 -0.5*s +n16)*coords[2+nLine+nCol][1] +(0.5*s3 -s2 +n23)*coords[m_maxCols+2+nLine+nCol][1] +(-0.5*s3 +0.5*s2 +0.5*s +n16)*coords[m_maxCols*2+2+nLine+nCol][1] +(n16*s3)*coords[m_maxCols*3+2+nLine+nCol][1]));
-						
-			double z = (-n16*((-n16*s3 +0.5*s2 -0.5*s +n16)*coords[0+nLine+nCol][2] +(0.5*s3 -s2 +n23)*coords[m_maxCols+nLine+nCol][2]   +(-0.5*s3 +0.5*s2 +0.5*s +n16)*coords[m_maxCols*2+nLine+nCol][2]   +(n16*s3)*coords[m_maxCols*3+nLine+nCol][2]) +0.5*((-n16*s3 +0.5*s2 -0.5*s +n16)*coords[1+nLine+nCol][2] +(0.5*s3 -s2 +n23)*coords[m_maxCols+1+nLine+nCol][2] +(-0.5*s3 +0.5*s2 +0.5*s +n16)*coords[m_maxCols*2+1+nLine+nCol][2] +(n16*s3)*coords[m_maxCols*3+1+nLine+nCol][2]) -0.5*((-n16*s3 +0.5*s2 -0.5*s +n16)*coords[2+nLine+nCol][2] +(0.5*s3 -s2 +n23)*coords[m_maxCols+2+nLine+nCol][2] +(-0.5*s3 +0.5*s2 +0.5*s +n16)*coords[m_maxCols*2+2+nLine+nCol][2] +(n16*s3)*coords[m_maxCols*3+2+nLine+nCol][2]) +n16*((-n16*s3 +0.5*s2 -0.5*s +n16)*coords[3+nLine+nCol][2] +(0.5*s3 -s2 +n23)*coords[m_maxCols+3+nLine+nCol][2] +(-0.5*s3 +0.5*s2 +0.5*s +n16)*coords[m_maxCols*2+3+nLine+nCol][2] +(n16*s3)*coords[m_maxCols*3+3+nLine+nCol][2]))*t3
-						+(0.5*((-n16*s3 +0.5*s2 -0.5*s +n16)*coords[0+nLine+nCol][2] +(0.5*s3 -s2 +n23)*coords[m_maxCols+nLine+nCol][2]   +(-0.5*s3 +0.5*s2 +0.5*s +n16)*coords[m_maxCols*2+nLine+nCol][2]   +(n16*s3)*coords[m_maxCols*3+nLine+nCol][2]) -((-n16*s3 +0.5*s2 -0.5*s +n16)*coords[1+nLine+nCol][2] +(0.5*s3 -s2 +n23)*coords[m_maxCols+1+nLine+nCol][2] +(-0.5*s3 +0.5*s2 +0.5*s +n16)*coords[m_maxCols*2+1+nLine+nCol][2] +(n16*s3)*coords[m_maxCols*3+1+nLine+nCol][2]) +0.5*((-n16*s3 +0.5*s2 -0.5*s +n16)*coords[2+nLine+nCol][2] +(0.5*s3 -s2 +n23)*coords[m_maxCols+2+nLine+nCol][2] +(-0.5*s3 +0.5*s2 +0.5*s +n16)*coords[m_maxCols*2+2+nLine+nCol][2] +(n16*s3)*coords[m_maxCols*3+2+nLine+nCol][2]))*t2
-						+(-0.5*((-n16*s3 +0.5*s2 -0.5*s +n16)*coords[0+nLine+nCol][2] +(0.5*s3 -s2 +n23)*coords[m_maxCols+nLine+nCol][2]   +(-0.5*s3 +0.5*s2 +0.5*s +n16)*coords[m_maxCols*2+nLine+nCol][2]   +(n16*s3)*coords[m_maxCols*3+nLine+nCol][2]) +0.5*((-n16*s3 +0.5*s2 -0.5*s +n16)*coords[2+nLine+nCol][2] +(0.5*s3 -s2 +n23)*coords[m_maxCols+2+nLine+nCol][2] +(-0.5*s3 +0.5*s2 +0.5*s +n16)*coords[m_maxCols*2+2+nLine+nCol][2] +(n16*s3)*coords[m_maxCols*3+2+nLine+nCol][2]))*t
-						+(n16*((-n16*s3 +0.5*s2 -0.5*s +n16)*coords[0+nLine+nCol][2] +(0.5*s3 -s2 +n23)*coords[m_maxCols+nLine+nCol][2]   +(-0.5*s3 +0.5*s2 +0.5*s +n16)*coords[m_maxCols*2+nLine+nCol][2]   +(n16*s3)*coords[m_maxCols*3+nLine+nCol][2]) +n23*((-n16*s3 +0.5*s2 -0.5*s +n16)*coords[1+nLine+nCol][2] +(0.5*s3 -s2 +n23)*coords[m_maxCols+1+nLine+nCol][2] +(-0.5*s3 +0.5*s2 +0.5*s +n16)*coords[m_maxCols*2+1+nLine+nCol][2] +(n16*s3)*coords[m_maxCols*3+1+nLine+nCol][2]) +n16*((-n16*s3 +0.5*s2 -0.5*s +n16)*coords[2+nLine+nCol][2] +(0.5*s3 -s2 +n23)*coords[m_maxCols+2+nLine+nCol][2] +(-0.5*s3 +0.5*s2 +0.5*s +n16)*coords[m_maxCols*2+2+nLine+nCol][2] +(n16*s3)*coords[m_maxCols*3+2+nLine+nCol][2]));
-
-			return Coordinate(x,y,z);
+			// one patch for every 4x4 window of the control grid
+			generatePatches(BsplineCurve::basis_matrix(), 1);
 		}
 };
 
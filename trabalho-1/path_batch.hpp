@@ -0,0 +1,171 @@
+#ifndef PATH_BATCH_HPP
+#define PATH_BATCH_HPP
+
+#include <vector>
+#include <algorithm>
+#include <cairo.h>
+#include "Transformation.hpp"
+
+/*
+	Device space subpaths that share one style, collected while the
+	display file is walked and handed to cairo as a single path with a
+	single cairo_stroke or cairo_fill, instead of one stroke (and one
+	round of cairo path and tessellation setup) per primitive.
+
+	Filled subpaths are all turned to the same winding as cairo_arc, so
+	that under the default nonzero fill rule overlapping polygons add up
+	instead of cancelling each other out, the same as filling them one
+	by one. That only holds for polygons wound one way all around: a
+	self-intersecting one has lobes wound both ways whatever it is
+	turned to, and another fill over its reversed lobe would cancel it
+	out. So only convex polygons (mesh triangles and faces, also after
+	clipping) and circles share the batched fill; any other polygon is
+	filled on its own.
+*/
+class PathBatch {
+	public:
+		explicit PathBatch(bool filled) : _filled(filled) {}
+
+		bool empty() const { return _subpaths.empty(); }
+
+		void clear() {
+			_points.clear();
+			_subpaths.clear();
+		}
+
+		void move_to(double x, double y) {
+			_subpaths.push_back({(int) _points.size(), 0, 0});
+			line_to(x, y);
+		}
+
+		void line_to(double x, double y) {
+			_points.push_back({x, y});
+			++_subpaths.back().count;
+		}
+
+		/* Ends the current subpath as a polygon: back to its first
+		   point when stroked; when filled, wound like cairo_arc if it
+		   is convex, or else set apart to be filled on its own */
+		void close_polygon();
+
+		void circle(double x, double y, double radius) {
+			_subpaths.push_back({(int) _points.size(), 1, radius});
+			_points.push_back({x, y});
+		}
+
+		/* Sends everything to cr as one path, draws it and starts over */
+		void flush(cairo_t* cr);
+
+	protected:
+	private:
+		struct Point2D {
+			double x, y;
+		};
+
+		struct Subpath {
+			int first, count;
+			double radius; // > 0 for circles, centered on their only point
+			bool alone = false; // filled with a cairo_fill of its own
+		};
+
+		bool is_convex(const Subpath& s) const;
+		void append(cairo_t* cr, const Subpath& s) const;
+
+		bool _filled;
+		std::vector<Point2D> _points;
+		std::vector<Subpath> _subpaths;
+};
+
+void PathBatch::close_polygon() {
+	Subpath& s = _subpaths.back();
+	if (!_filled) {
+		Point2D first = _points[s.first];
+		line_to(first.x, first.y);
+		return;
+	}
+
+	if (!is_convex(s)) {
+		s.alone = true;
+		return;
+	}
+
+	// shoelace; cairo_arc goes from +x towards +y, which is positive here
+	double area = 0;
+	for (int i = 0; i < s.count; ++i) {
+		const Point2D& a = _points[s.first + i];
+		const Point2D& b = _points[s.first + (i + 1) % s.count];
+		area += a.x * b.y - b.x * a.y;
+	}
+	if (area < 0)
+		std::reverse(_points.begin() + s.first, _points.begin() + s.first + s.count);
+}
+
+/* Every turn the same way and a single turn around: x goes back and
+   forth once, a star polygon's more often */
+bool PathBatch::is_convex(const Subpath& s) const {
+	int turn = 0, x_changes = 0;
+	double first_dx = 0, last_dx = 0;
+	for (int i = 0; i < s.count; ++i) {
+		const Point2D& a = _points[s.first + i];
+		const Point2D& b = _points[s.first + (i + 1) % s.count];
+		const Point2D& c = _points[s.first + (i + 2) % s.count];
+		double cross = (b.x - a.x) * (c.y - b.y) - (b.y - a.y) * (c.x - b.x);
+		if (cross != 0) {
+			if (turn == 0)
+				turn = cross > 0 ? 1 : -1;
+			else if ((cross > 0) != (turn > 0))
+				return false;
+		}
+		double dx = b.x - a.x;
+		if (dx != 0) {
+			if (first_dx == 0)
+				first_dx = dx;
+			else if ((dx > 0) != (last_dx > 0))
+				++x_changes;
+			last_dx = dx;
+		}
+	}
+	// and from the last edge back to the first
+	if ((first_dx > 0) != (last_dx > 0))
+		++x_changes;
+	return x_changes <= 2;
+}
+
+void PathBatch::append(cairo_t* cr, const Subpath& s) const {
+	const Point2D* p = &_points[s.first];
+	if (s.radius > 0) {
+		cairo_new_sub_path(cr);
+		cairo_arc(cr, p[0].x, p[0].y, s.radius, 0.0, 2*PI);
+		return;
+	}
+	cairo_move_to(cr, p[0].x, p[0].y);
+	for (int i = 1; i < s.count; ++i)
+		cairo_line_to(cr, p[i].x, p[i].y);
+}
+
+void PathBatch::flush(cairo_t* cr) {
+	if (empty())
+		return;
+
+	bool batched = false;
+	for (const auto &s : _subpaths)
+		if (!s.alone) {
+			append(cr, s);
+			batched = true;
+		}
+	if (batched) {
+		if (_filled)
+			cairo_fill(cr);
+		else
+			cairo_stroke(cr);
+	}
+
+	for (const auto &s : _subpaths)
+		if (s.alone) {
+			append(cr, s);
+			cairo_fill(cr);
+		}
+	clear();
+}
+
+#endif // PATH_BATCH_HPP
@@ -0,0 +1,272 @@
+#ifndef RASTERIZER_HPP
+#define RASTERIZER_HPP
+
+#include <vector>
+#include <cstdint>
+#include <cmath>
+#include <limits>
+#include <algorithm>
+#include <cairo.h>
+#include "worker_pool.hpp"
+
+#if defined(__AVX__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+/*
+	Software rasterizer for filled polygons, used by the Viewport in
+	place of cairo_fill when depth matters: every polygon is split in a
+	fan of triangles and drawn with edge functions and a float z-buffer
+	(smaller z is closer) into a cairo ARGB32 image surface, which is
+	then painted on the target context in one go.
+
+	The image is cut in TILE_SIZE x TILE_SIZE tiles. Triangles are
+	binned by the tiles their bounding box touches, and each tile
+	(clear, depth test, shading) is one work item of the WorkerPool, so
+	no two threads ever write the same pixel. Within a row the pixels
+	go 8 at a time with AVX, 4 with SSE2, one by one otherwise.
+*/
+class Rasterizer {
+	public:
+		/* Pixel coords, in the space of the image, plus depth */
+		struct Vertex {
+			float x, y, z;
+		};
+
+		Rasterizer() {}
+		~Rasterizer();
+
+		Rasterizer(const Rasterizer&) = delete;
+		Rasterizer& operator=(const Rasterizer&) = delete;
+
+		/* Starts a frame of width x height pixels, without triangles */
+		void begin(int width, int height);
+
+		/* Convex polygon v[0..n), color as premultiplied ARGB32 */
+		void add_polygon(const Vertex* v, int n, std::uint32_t color);
+
+		std::size_t triangle_count() const { return _triangles.size(); }
+
+		/* Rasterizes the frame on workers and paints it on cr with its
+		   top left corner at (x, y); pixels nothing covered are left
+		   transparent */
+		void draw(cairo_t* cr, double x, double y, WorkerPool& workers);
+
+	protected:
+	private:
+		struct Triangle {
+			Vertex v[3];
+			std::uint32_t color;
+			int min_x, min_y, max_x, max_y; // pixels, inclusive
+		};
+
+		static const int TILE_SIZE = 64;
+
+		void add_triangle(const Vertex& a, const Vertex& b, const Vertex& c, std::uint32_t color);
+		void raster_tile(int tile);
+		void raster_triangle(const Triangle& t, int x0, int y0, int x1, int y1);
+
+		int _width = 0, _height = 0;
+		int _tiles_x = 0, _tiles_y = 0;
+		std::vector<Triangle> _triangles;
+		std::vector<std::vector<int>> _bins; // triangles touching each tile
+
+		cairo_surface_t* _surface = nullptr;
+		std::uint32_t* _pixels = nullptr;
+		std::vector<float> _depth;
+		int _stride = 0; // of both buffers, in pixels
+};
+
+Rasterizer::~Rasterizer() {
+	if (_surface != nullptr)
+		cairo_surface_destroy(_surface);
+}
+
+void Rasterizer::begin(int width, int height) {
+	_triangles.clear();
+	if (width == _width && height == _height)
+		return;
+
+	_width = width;
+	_height = height;
+	_tiles_x = (width + TILE_SIZE - 1) / TILE_SIZE;
+	_tiles_y = (height + TILE_SIZE - 1) / TILE_SIZE;
+	_bins.resize(_tiles_x * _tiles_y);
+
+	// whole tiles, so that the SIMD rows never leave the buffers
+	if (_surface != nullptr)
+		cairo_surface_destroy(_surface);
+	_surface = cairo_image_surface_create(CAIRO_FORMAT_ARGB32, _tiles_x * TILE_SIZE, _tiles_y * TILE_SIZE);
+	_pixels = (std::uint32_t*) cairo_image_surface_get_data(_surface);
+	_stride = cairo_image_surface_get_stride(_surface) / 4;
+	_depth.resize((std::size_t) _stride * _tiles_y * TILE_SIZE);
+}
+
+void Rasterizer::add_polygon(const Vertex* v, int n, std::uint32_t color) {
+	for (int i = 1; i + 1 < n; ++i)
+		add_triangle(v[0], v[i], v[i+1], color);
+}
+
+void Rasterizer::add_triangle(const Vertex& a, const Vertex& b, const Vertex& c, std::uint32_t color) {
+	Triangle t;
+	t.v[0] = a;
+	t.v[1] = b;
+	t.v[2] = c;
+	t.color = color;
+
+	// pixel (x, y) is sampled at its center (x + 0.5, y + 0.5)
+	float min_x = std::min({a.x, b.x, c.x}), max_x = std::max({a.x, b.x, c.x});
+	float min_y = std::min({a.y, b.y, c.y}), max_y = std::max({a.y, b.y, c.y});
+	t.min_x = std::max(0, (int) std::floor(min_x));
+	t.min_y = std::max(0, (int) std::floor(min_y));
+	t.max_x = std::min(_width - 1, (int) std::ceil(max_x));
+	t.max_y = std::min(_height - 1, (int) std::ceil(max_y));
+	if (t.min_x > t.max_x || t.min_y > t.max_y)
+		return;
+	_triangles.push_back(t);
+}
+
+void Rasterizer::draw(cairo_t* cr, double x, double y, WorkerPool& workers) {
+	if (_pixels == nullptr)
+		return;
+
+	for (auto &bin : _bins)
+		bin.clear();
+	for (int i = 0; i < _triangles.size(); ++i) {
+		const Triangle& t = _triangles[i];
+		for (int ty = t.min_y / TILE_SIZE; ty <= t.max_y / TILE_SIZE; ++ty)
+			for (int tx = t.min_x / TILE_SIZE; tx <= t.max_x / TILE_SIZE; ++tx)
+				_bins[ty * _tiles_x + tx].push_back(i);
+	}
+
+	cairo_surface_flush(_surface);
+	workers.parallel_for(_bins.size(), 1, [this](std::size_t tile) {
+		raster_tile(tile);
+	});
+	cairo_surface_mark_dirty(_surface);
+
+	cairo_save(cr);
+	cairo_set_source_surface(cr, _surface, x, y);
+	cairo_rectangle(cr, x, y, _width, _height);
+	cairo_fill(cr);
+	cairo_restore(cr);
+}
+
+void Rasterizer::raster_tile(int tile) {
+	int x0 = (tile % _tiles_x) * TILE_SIZE, y0 = (tile / _tiles_x) * TILE_SIZE;
+	int x1 = x0 + TILE_SIZE - 1, y1 = y0 + TILE_SIZE - 1;
+
+	for (int y = y0; y <= y1; ++y) {
+		std::size_t row = (std::size_t) y * _stride;
+		std::fill(_pixels + row + x0, _pixels + row + x1 + 1, 0u);
+		std::fill(_depth.begin() + row + x0, _depth.begin() + row + x1 + 1, std::numeric_limits<float>::infinity());
+	}
+
+	for (int i : _bins[tile]) {
+		const Triangle& t = _triangles[i];
+		raster_triangle(t, std::max(x0, t.min_x), std::max(y0, t.min_y),
+						std::min(x1, t.max_x), std::min(y1, t.max_y));
+	}
+}
+
+/*
+	Draws the part of t inside [x0, x1] x [y0, y1], which lies in a
+	single tile. Edge i (opposite to vertex i) is e_i(x, y) = a_i x +
+	b_i y + c_i, positive inside once the triangle is counterclockwise,
+	and depth is the plane through the 3 vertices.
+*/
+void Rasterizer::raster_triangle(const Triangle& t, int x0, int y0, int x1, int y1) {
+	const Vertex* v[3] = {&t.v[0], &t.v[1], &t.v[2]};
+	float area = (v[1]->x - v[0]->x) * (v[2]->y - v[0]->y) - (v[1]->y - v[0]->y) * (v[2]->x - v[0]->x);
+	if (area == 0)
+		return;
+	if (area < 0) {
+		std::swap(v[1], v[2]);
+		area = -area;
+	}
+
+	float a[3], b[3], c[3];
+	for (int i = 0; i < 3; ++i) {
+		const Vertex& p = *v[(i + 1) % 3];
+		const Vertex& q = *v[(i + 2) % 3];
+		a[i] = p.y - q.y;
+		b[i] = q.x - p.x;
+		c[i] = -(a[i] * p.x + b[i] * p.y);
+	}
+	float za = (a[0] * v[0]->z + a[1] * v[1]->z + a[2] * v[2]->z) / area;
+	float zb = (b[0] * v[0]->z + b[1] * v[1]->z + b[2] * v[2]->z) / area;
+	float zc = (c[0] * v[0]->z + c[1] * v[1]->z + c[2] * v[2]->z) / area;
+
+#if defined(__AVX__)
+	const int LANES = 8;
+	__m256 lane = _mm256_setr_ps(0, 1, 2, 3, 4, 5, 6, 7);
+	__m256 zero = _mm256_setzero_ps();
+	__m256 color = _mm256_castsi256_ps(_mm256_set1_epi32(t.color));
+	__m256 a0 = _mm256_set1_ps(a[0]), a1 = _mm256_set1_ps(a[1]), a2 = _mm256_set1_ps(a[2]), az = _mm256_set1_ps(za);
+#elif defined(__SSE2__)
+	const int LANES = 4;
+	__m128 lane = _mm_setr_ps(0, 1, 2, 3);
+	__m128 zero = _mm_setzero_ps();
+	__m128 color = _mm_castsi128_ps(_mm_set1_epi32(t.color));
+	__m128 a0 = _mm_set1_ps(a[0]), a1 = _mm_set1_ps(a[1]), a2 = _mm_set1_ps(a[2]), az = _mm_set1_ps(za);
+#else
+	const int LANES = 1;
+#endif
+
+	// rows start on a multiple of LANES; tiles are too, so a row never
+	// reaches past its tile
+	int xs = x0 - x0 % LANES;
+	for (int y = y0; y <= y1; ++y) {
+		float px = xs + 0.5f, py = y + 0.5f;
+		float e0 = a[0] * px + b[0] * py + c[0];
+		float e1 = a[1] * px + b[1] * py + c[1];
+		float e2 = a[2] * px + b[2] * py + c[2];
+		float z = za * px + zb * py + zc;
+		std::uint32_t* pixels = _pixels + (std::size_t) y * _stride;
+		float* depth = _depth.data() + (std::size_t) y * _stride;
+
+		for (int x = xs; x <= x1; x += LANES) {
+			float dx = x - xs;
+#if defined(__AVX__)
+			__m256 offset = _mm256_add_ps(_mm256_set1_ps(dx), lane);
+			__m256 in = _mm256_and_ps(
+				_mm256_cmp_ps(_mm256_add_ps(_mm256_set1_ps(e0), _mm256_mul_ps(a0, offset)), zero, _CMP_GE_OQ),
+				_mm256_cmp_ps(_mm256_add_ps(_mm256_set1_ps(e1), _mm256_mul_ps(a1, offset)), zero, _CMP_GE_OQ));
+			in = _mm256_and_ps(in,
+				_mm256_cmp_ps(_mm256_add_ps(_mm256_set1_ps(e2), _mm256_mul_ps(a2, offset)), zero, _CMP_GE_OQ));
+			if (_mm256_movemask_ps(in) == 0)
+				continue;
+			__m256 zv = _mm256_add_ps(_mm256_set1_ps(z), _mm256_mul_ps(az, offset));
+			__m256 old = _mm256_loadu_ps(depth + x);
+			__m256 pass = _mm256_and_ps(in, _mm256_cmp_ps(zv, old, _CMP_LT_OQ));
+			_mm256_storeu_ps(depth + x, _mm256_blendv_ps(old, zv, pass));
+			__m256 pixel = _mm256_loadu_ps((float*) (pixels + x));
+			_mm256_storeu_ps((float*) (pixels + x), _mm256_blendv_ps(pixel, color, pass));
+#elif defined(__SSE2__)
+			__m128 offset = _mm_add_ps(_mm_set1_ps(dx), lane);
+			__m128 in = _mm_and_ps(
+				_mm_cmpge_ps(_mm_add_ps(_mm_set1_ps(e0), _mm_mul_ps(a0, offset)), zero),
+				_mm_cmpge_ps(_mm_add_ps(_mm_set1_ps(e1), _mm_mul_ps(a1, offset)), zero));
+			in = _mm_and_ps(in, _mm_cmpge_ps(_mm_add_ps(_mm_set1_ps(e2), _mm_mul_ps(a2, offset)), zero));
+			if (_mm_movemask_ps(in) == 0)
+				continue;
+			__m128 zv = _mm_add_ps(_mm_set1_ps(z), _mm_mul_ps(az, offset));
+			__m128 old = _mm_loadu_ps(depth + x);
+			__m128 pass = _mm_and_ps(in, _mm_cmplt_ps(zv, old));
+			_mm_storeu_ps(depth + x, _mm_or_ps(_mm_and_ps(pass, zv), _mm_andnot_ps(pass, old)));
+			__m128 pixel = _mm_loadu_ps((float*) (pixels + x));
+			_mm_storeu_ps((float*) (pixels + x), _mm_or_ps(_mm_and_ps(pass, color), _mm_andnot_ps(pass, pixel)));
+#else
+			if (e0 + a[0] * dx >= 0 && e1 + a[1] * dx >= 0 && e2 + a[2] * dx >= 0) {
+				float zx = z + za * dx;
+				if (zx < depth[x]) {
+					depth[x] = zx;
+					pixels[x] = t.color;
+				}
+			}
+#endif
+		}
+	}
+}
+
+#endif // RASTERIZER_HPP
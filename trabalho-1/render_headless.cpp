@@ -0,0 +1,222 @@
+/*
+	Headless renderer: loads an .obj through ObjReader and draws it with
+	Viewport into a cairo image surface the size of the GTK drawing area,
+	without opening a display. Prints per-frame latency percentiles, so
+	rendering cost can be tracked on machines with no display.
+
+	Each frame is what draw_objects does in main_window.cpp (clear, draw
+	the display file, viewport border). With --orbit the window also
+	turns around its y axis before every frame, so normalization and
+	clipping are part of the measured time; without it only drawing is.
+
+	cd trabalho-1
+	g++ -std=c++17 -O2 -march=native -pthread render_headless.cpp -o render_headless `pkg-config --cflags --libs cairo`
+	./render_headless subzero.obj --view perspective --fov 60 --frames 500 --orbit 1
+
+	options:
+		--center x,y,z     window center (default: middle of the viewport, z = 0)
+		--angles x,y,z     window rotation in degrees (default 0,0,0)
+		--view parallel|perspective
+		--fov degrees      field of view of the perspective projection
+		--backend cairo|raster
+		                   how filled polygons are drawn (default cairo,
+		                   raster is the z-buffer of rasterizer.hpp)
+		--backface-culling on|off
+		                   drop faces seen from behind on every 3D
+		                   object (default off)
+		--frames n         frames to time (default 100)
+		--orbit degrees    rotation around y added before each frame
+		--png file         writes the last frame
+		--stats file       per-frame stage timers and counters, one JSON
+		                   object per line (needs -DFRAME_STATS, see
+		                   frame_stats.hpp)
+*/
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+#include "Viewport.hpp"
+#include "file_handler.hpp"
+
+static const int VIEWPORT_WIDTH = 510, VIEWPORT_HEIGHT = 515;
+static const int SURFACE_WIDTH = 530, SURFACE_HEIGHT = 535;
+
+static void draw_frame(Viewport& viewport, cairo_t* cr) {
+	cairo_set_source_rgb(cr, 1, 1, 1);
+	cairo_paint(cr);
+
+	cairo_set_source_rgb(cr, 0, 0, 0);
+	cairo_set_line_width(cr, 1.0);
+	viewport.drawDisplayFile(cr);
+
+	cairo_set_line_width(cr, 2.0);
+	cairo_move_to(cr, 10, 10);
+	cairo_line_to(cr, 520, 10);
+	cairo_line_to(cr, 520, 525);
+	cairo_line_to(cr, 10, 525);
+	cairo_line_to(cr, 10, 10);
+	cairo_stroke(cr);
+}
+
+static bool parse_triple(const char* s, double v[3]) {
+	return std::sscanf(s, "%lf,%lf,%lf", &v[0], &v[1], &v[2]) == 3;
+}
+
+static double percentile(const std::vector<double>& sorted, double p) {
+	std::size_t rank = std::max<std::size_t>(1, (std::size_t) std::ceil(p / 100 * sorted.size()));
+	return sorted[std::min(rank, sorted.size()) - 1];
+}
+
+static int usage(const char* program) {
+	std::fprintf(stderr,
+		"usage: %s file.obj [--center x,y,z] [--angles x,y,z] [--view parallel|perspective]\n"
+		"       [--fov degrees] [--backend cairo|raster]\n"
+		"       [--backface-culling on|off] [--frames n] [--orbit degrees] [--png file] [--stats file]\n", program);
+	return 1;
+}
+
+int main(int argc, char* argv[]) {
+	if (argc < 2)
+		return usage(argv[0]);
+
+	std::string path = argv[1];
+	double center[3] = {VIEWPORT_WIDTH/2.0, VIEWPORT_HEIGHT/2.0, 0};
+	double angles[3] = {0, 0, 0};
+	window_view view = window_view::PERSPECTIVE;
+	double fov = 0;
+	Render_backends backend = Render_backends::CAIRO;
+	bool backface_culling = false;
+	int frames = 100;
+	double orbit = 0;
+	const char* png = nullptr;
+	const char* stats = nullptr;
+
+	for (int i = 2; i < argc; ++i) {
+		const char* arg = argv[i];
+		const char* value = i + 1 < argc ? argv[i+1] : nullptr;
+		if (value == nullptr)
+			return usage(argv[0]);
+		++i;
+
+		if (!std::strcmp(arg, "--center")) {
+			if (!parse_triple(value, center))
+				return usage(argv[0]);
+		} else if (!std::strcmp(arg, "--angles")) {
+			if (!parse_triple(value, angles))
+				return usage(argv[0]);
+		} else if (!std::strcmp(arg, "--view")) {
+			if (!std::strcmp(value, "parallel"))
+				view = window_view::PARALLEL;
+			else if (!std::strcmp(value, "perspective"))
+				view = window_view::PERSPECTIVE;
+			else
+				return usage(argv[0]);
+		} else if (!std::strcmp(arg, "--fov")) {
+			fov = std::atof(value);
+		} else if (!std::strcmp(arg, "--backend")) {
+			if (!std::strcmp(value, "cairo"))
+				backend = Render_backends::CAIRO;
+			else if (!std::strcmp(value, "raster"))
+				backend = Render_backends::RASTER;
+			else
+				return usage(argv[0]);
+		} else if (!std::strcmp(arg, "--backface-culling")) {
+			if (!std::strcmp(value, "on"))
+				backface_culling = true;
+			else if (!std::strcmp(value, "off"))
+				backface_culling = false;
+			else
+				return usage(argv[0]);
+		} else if (!std::strcmp(arg, "--frames")) {
+			frames = std::max(1, std::atoi(value));
+		} else if (!std::strcmp(arg, "--orbit")) {
+			orbit = std::atof(value);
+		} else if (!std::strcmp(arg, "--png")) {
+			png = value;
+		} else if (!std::strcmp(arg, "--stats")) {
+			stats = value;
+		} else {
+			return usage(argv[0]);
+		}
+	}
+
+#ifndef FRAME_STATS
+	if (stats != nullptr) {
+		std::fprintf(stderr, "--stats needs a build with -DFRAME_STATS\n");
+		return 1;
+	}
+#endif
+	std::FILE* stats_file = nullptr;
+	if (stats != nullptr && (stats_file = std::fopen(stats, "w")) == nullptr) {
+		std::fprintf(stderr, "could not write %s\n", stats);
+		return 1;
+	}
+
+	Viewport viewport(VIEWPORT_WIDTH, VIEWPORT_HEIGHT);
+	viewport.change_view(view);
+	viewport.set_render_backend(backend);
+	if (fov > 0)
+		viewport.set_focal_distance(Transformation::to_radians(fov));
+	viewport.set_camera(Coordinate(center[0], center[1], center[2]), angles[0], angles[1], angles[2]);
+
+	auto load_start = std::chrono::steady_clock::now();
+	try {
+		ObjReader reader(path);
+		for (auto obj : reader.getObjs()) {
+			if (obj->get_type() == obj_type::OBJECT_3D)
+				((Object3D*) obj)->set_backface_culling(backface_culling);
+			viewport.addObject(obj);
+		}
+	} catch (const char* e) {
+		std::fprintf(stderr, "%s: %s\n", path.c_str(), e);
+		return 1;
+	}
+	auto load_end = std::chrono::steady_clock::now();
+
+	cairo_surface_t* surface = cairo_image_surface_create(CAIRO_FORMAT_ARGB32, SURFACE_WIDTH, SURFACE_HEIGHT);
+	cairo_t* cr = cairo_create(surface);
+
+	// warm-up frame (cold caches, first cairo allocations), not timed
+	draw_frame(viewport, cr);
+	frame_stats().end_frame();
+
+	std::vector<double> times;
+	times.reserve(frames);
+	for (int f = 0; f < frames; ++f) {
+		auto start = std::chrono::steady_clock::now();
+		if (orbit != 0)
+			viewport.rotate_window_on_y(orbit);
+		draw_frame(viewport, cr);
+		cairo_surface_flush(surface);
+		auto end = std::chrono::steady_clock::now();
+		times.push_back(std::chrono::duration<double, std::milli>(end - start).count());
+
+		frame_stats().end_frame();
+		if (stats_file != nullptr)
+			frame_stats().write_json(stats_file);
+	}
+	if (stats_file != nullptr)
+		std::fclose(stats_file);
+
+	if (png != nullptr && cairo_surface_write_to_png(surface, png) != CAIRO_STATUS_SUCCESS)
+		std::fprintf(stderr, "could not write %s\n", png);
+
+	cairo_destroy(cr);
+	cairo_surface_destroy(surface);
+
+	double mean = 0;
+	for (double t : times)
+		mean += t;
+	mean /= times.size();
+	std::sort(times.begin(), times.end());
+
+	std::printf("%s: %d objects, loaded in %.1f ms\n", path.c_str(), viewport.get_display_file_size(),
+				std::chrono::duration<double, std::milli>(load_end - load_start).count());
+	std::printf("%d frames (ms): mean %.3f  p50 %.3f  p90 %.3f  p99 %.3f  max %.3f\n", frames, mean,
+				percentile(times, 50), percentile(times, 90), percentile(times, 99), times.back());
+	return 0;
+}
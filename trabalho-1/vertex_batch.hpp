@@ -0,0 +1,169 @@
+#ifndef VERTEX_BATCH_HPP
+#define VERTEX_BATCH_HPP
+
+#include <vector>
+#include <cstddef>
+#include "coordinate.hpp"
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#endif
+
+/*
+	Structure-of-arrays vertex buffer: x, y, z and w of every vertex in
+	separate contiguous arrays, so the window transform can run over 4
+	vertices per AVX instruction instead of one Coordinate at a time.
+	w is always 1 on input; on output it is what the window matrix gave,
+	the divide is left to Clipping.
+*/
+class VertexBatch {
+	public:
+		VertexBatch() {}
+
+		std::size_t size() const { return _x.size(); }
+
+		void clear() {
+			_x.clear();
+			_y.clear();
+			_z.clear();
+			_w.clear();
+		}
+
+		void reserve(std::size_t n) {
+			_x.reserve(n);
+			_y.reserve(n);
+			_z.reserve(n);
+			_w.reserve(n);
+		}
+
+		void resize(std::size_t n) {
+			_x.resize(n);
+			_y.resize(n);
+			_z.resize(n);
+			_w.resize(n, 1);
+		}
+
+		void push_back(const Coordinate& c) {
+			_x.push_back(c[0]);
+			_y.push_back(c[1]);
+			_z.push_back(c[2]);
+			_w.push_back(1);
+		}
+
+		void push_back(const Coordinates& coords) {
+			for (const auto &c : coords)
+				push_back(c);
+		}
+
+		Coordinate get(std::size_t i) const {
+			return Vec4{ {_x[i], _y[i], _z[i], _w[i]} };
+		}
+
+		/* out[k] = (x, y, z, w) of vertex offset+k, for k in [0, n) */
+		void copy_to(std::size_t offset, Coordinate* out, std::size_t n) const;
+
+		const double* x() const { return _x.data(); }
+		const double* y() const { return _y.data(); }
+		const double* z() const { return _z.data(); }
+		const double* w() const { return _w.data(); }
+		double* x() { return _x.data(); }
+		double* y() { return _y.data(); }
+		double* z() { return _z.data(); }
+		double* w() { return _w.data(); }
+
+		/* Adds (dx, dy, dz) to vertices [begin, end) */
+		void translate(std::size_t begin, std::size_t end, double dx, double dy, double dz) {
+			for (std::size_t i = begin; i < end; ++i) {
+				_x[i] += dx;
+				_y[i] += dy;
+				_z[i] += dz;
+			}
+		}
+
+		/* out[i] = in[i] * m, for i in [begin, end); w is not divided out */
+		static void transform(const Matrix& m, const VertexBatch& in, VertexBatch& out,
+							  std::size_t begin, std::size_t end);
+
+		static void transform(const Matrix& m, const VertexBatch& in, VertexBatch& out) {
+			out.resize(in.size());
+			transform(m, in, out, 0, in.size());
+		}
+
+	protected:
+	private:
+		std::vector<double> _x, _y, _z, _w;
+};
+
+void VertexBatch::transform(const Matrix& m, const VertexBatch& in, VertexBatch& out,
+							std::size_t begin, std::size_t end) {
+	const double *ix = in.x(), *iy = in.y(), *iz = in.z();
+	double *ox = out.x(), *oy = out.y(), *oz = out.z(), *ow = out.w();
+	std::size_t i = begin;
+
+#if defined(__AVX__)
+	__m256d m00 = _mm256_set1_pd(m[0][0]), m01 = _mm256_set1_pd(m[0][1]), m02 = _mm256_set1_pd(m[0][2]), m03 = _mm256_set1_pd(m[0][3]);
+	__m256d m10 = _mm256_set1_pd(m[1][0]), m11 = _mm256_set1_pd(m[1][1]), m12 = _mm256_set1_pd(m[1][2]), m13 = _mm256_set1_pd(m[1][3]);
+	__m256d m20 = _mm256_set1_pd(m[2][0]), m21 = _mm256_set1_pd(m[2][1]), m22 = _mm256_set1_pd(m[2][2]), m23 = _mm256_set1_pd(m[2][3]);
+	__m256d m30 = _mm256_set1_pd(m[3][0]), m31 = _mm256_set1_pd(m[3][1]), m32 = _mm256_set1_pd(m[3][2]), m33 = _mm256_set1_pd(m[3][3]);
+
+#if defined(__FMA__)
+#define VB_ROW(c0, c1, c2, c3) _mm256_add_pd(_mm256_fmadd_pd(z, c2, _mm256_fmadd_pd(y, c1, _mm256_mul_pd(x, c0))), c3)
+#else
+#define VB_ROW(c0, c1, c2, c3) _mm256_add_pd(_mm256_add_pd(_mm256_add_pd(_mm256_mul_pd(x, c0), _mm256_mul_pd(y, c1)), _mm256_mul_pd(z, c2)), c3)
+#endif
+	for (; i + 4 <= end; i += 4) {
+		__m256d x = _mm256_loadu_pd(ix + i);
+		__m256d y = _mm256_loadu_pd(iy + i);
+		__m256d z = _mm256_loadu_pd(iz + i);
+
+		_mm256_storeu_pd(ox + i, VB_ROW(m00, m10, m20, m30));
+		_mm256_storeu_pd(oy + i, VB_ROW(m01, m11, m21, m31));
+		_mm256_storeu_pd(oz + i, VB_ROW(m02, m12, m22, m32));
+		_mm256_storeu_pd(ow + i, VB_ROW(m03, m13, m23, m33));
+	}
+#undef VB_ROW
+#endif
+
+	// scalar fallback and tail
+	for (; i < end; ++i) {
+		double x = ix[i], y = iy[i], z = iz[i];
+		ox[i] = x * m[0][0] + y * m[1][0] + z * m[2][0] + m[3][0];
+		oy[i] = x * m[0][1] + y * m[1][1] + z * m[2][1] + m[3][1];
+		oz[i] = x * m[0][2] + y * m[1][2] + z * m[2][2] + m[3][2];
+		ow[i] = x * m[0][3] + y * m[1][3] + z * m[2][3] + m[3][3];
+	}
+}
+
+void VertexBatch::copy_to(std::size_t offset, Coordinate* out, std::size_t n) const {
+	const double *ix = x() + offset, *iy = y() + offset, *iz = z() + offset, *iw = w() + offset;
+	std::size_t k = 0;
+
+#if defined(__AVX__)
+	// 4x4 transpose of [x y z w] rows into 4 Coordinates
+	for (; k + 4 <= n; k += 4) {
+		__m256d x = _mm256_loadu_pd(ix + k);
+		__m256d y = _mm256_loadu_pd(iy + k);
+		__m256d z = _mm256_loadu_pd(iz + k);
+		__m256d w = _mm256_loadu_pd(iw + k);
+
+		__m256d xy_lo = _mm256_unpacklo_pd(x, y);   // x0 y0 x2 y2
+		__m256d xy_hi = _mm256_unpackhi_pd(x, y);   // x1 y1 x3 y3
+		__m256d zw_lo = _mm256_unpacklo_pd(z, w);   // z0 w0 z2 w2
+		__m256d zw_hi = _mm256_unpackhi_pd(z, w);   // z1 w1 z3 w3
+
+		_mm256_store_pd(out[k+0].v, _mm256_permute2f128_pd(xy_lo, zw_lo, 0x20));
+		_mm256_store_pd(out[k+1].v, _mm256_permute2f128_pd(xy_hi, zw_hi, 0x20));
+		_mm256_store_pd(out[k+2].v, _mm256_permute2f128_pd(xy_lo, zw_lo, 0x31));
+		_mm256_store_pd(out[k+3].v, _mm256_permute2f128_pd(xy_hi, zw_hi, 0x31));
+	}
+#endif
+
+	for (; k < n; ++k) {
+		out[k][0] = ix[k];
+		out[k][1] = iy[k];
+		out[k][2] = iz[k];
+		out[k][3] = iw[k];
+	}
+}
+
+#endif // VERTEX_BATCH_HPP
@@ -0,0 +1,154 @@
+#ifndef WORKER_POOL_HPP
+#define WORKER_POOL_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/*
+	Fixed set of worker threads for data parallel loops.
+
+	parallel_for splits [0, n) into one contiguous range per thread (the
+	calling thread counts as one). Each thread claims chunks from its own
+	range through an atomic cursor and, once that runs out, claims the
+	remaining chunks of the other ranges the same way, so a thread stuck
+	behind expensive items does not hold the others back.
+
+	parallel_for only returns after every item has run, so whatever the
+	items wrote is complete and visible to the caller afterwards.
+*/
+class WorkerPool {
+	public:
+		typedef std::function<void(std::size_t)> Task;
+
+		/* threads = 0 uses one thread per core */
+		explicit WorkerPool(unsigned threads = 0);
+		~WorkerPool();
+
+		WorkerPool(const WorkerPool&) = delete;
+		WorkerPool& operator=(const WorkerPool&) = delete;
+
+		unsigned size() const { return _workers.size() + 1; }
+
+		/* task(i) for every i in [0, n), claimed chunk items at a time */
+		void parallel_for(std::size_t n, std::size_t chunk, const Task& task);
+
+	protected:
+	private:
+		struct alignas(64) Range {
+			std::atomic<std::size_t> next;
+			std::size_t end;
+		};
+
+		void worker_loop(unsigned self);
+		void run(unsigned self);
+
+		std::vector<std::thread> _workers;
+		std::unique_ptr<Range[]> _ranges;
+
+		const Task* _task = nullptr;
+		std::size_t _chunk = 1;
+
+		std::mutex _mutex;
+		std::condition_variable _start;
+		std::condition_variable _done;
+		unsigned _generation = 0;
+		unsigned _pending = 0;
+		bool _quit = false;
+};
+
+WorkerPool::WorkerPool(unsigned threads) {
+	if (threads == 0)
+		threads = std::max(1u, std::thread::hardware_concurrency());
+
+	_ranges.reset(new Range[threads]);
+	for (unsigned i = 1; i < threads; ++i)
+		_workers.emplace_back(&WorkerPool::worker_loop, this, i);
+}
+
+WorkerPool::~WorkerPool() {
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		_quit = true;
+	}
+	_start.notify_all();
+	for (auto &t : _workers)
+		t.join();
+}
+
+void WorkerPool::parallel_for(std::size_t n, std::size_t chunk, const Task& task) {
+	if (n == 0)
+		return;
+	chunk = std::max<std::size_t>(chunk, 1);
+
+	// not worth waking anybody up
+	if (_workers.empty() || n <= chunk) {
+		for (std::size_t i = 0; i < n; ++i)
+			task(i);
+		return;
+	}
+
+	unsigned threads = size();
+	for (unsigned t = 0; t < threads; ++t) {
+		_ranges[t].next.store(n * t / threads, std::memory_order_relaxed);
+		_ranges[t].end = n * (t+1) / threads;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		_task = &task;
+		_chunk = chunk;
+		_pending = _workers.size();
+		++_generation;
+	}
+	_start.notify_all();
+
+	run(0);
+
+	std::unique_lock<std::mutex> lock(_mutex);
+	_done.wait(lock, [this] { return _pending == 0; });
+	_task = nullptr;
+}
+
+void WorkerPool::worker_loop(unsigned self) {
+	unsigned seen = 0;
+	while (true) {
+		{
+			std::unique_lock<std::mutex> lock(_mutex);
+			_start.wait(lock, [&] { return _quit || _generation != seen; });
+			if (_quit)
+				return;
+			seen = _generation;
+		}
+
+		run(self);
+
+		std::lock_guard<std::mutex> lock(_mutex);
+		if (--_pending == 0)
+			_done.notify_one();
+	}
+}
+
+void WorkerPool::run(unsigned self) {
+	unsigned threads = size();
+	// own range first, then steal from the others
+	for (unsigned k = 0; k < threads; ++k) {
+		Range& r = _ranges[(self + k) % threads];
+		while (true) {
+			std::size_t i = r.next.fetch_add(_chunk, std::memory_order_relaxed);
+			if (i >= r.end)
+				break;
+			std::size_t end = std::min(i + _chunk, r.end);
+			for (; i < end; ++i)
+				(*_task)(i);
+		}
+	}
+}
+
+#endif // WORKER_POOL_HPP